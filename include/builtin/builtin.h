@@ -17,6 +17,7 @@
 #ifndef BUILTIN_H
 #define BUILTIN_H
 
+#include "builtin/path_cache.h"
 #include "interpreter/interpreter.h"
 #include "lib/arena_ll.h"
 #include "options.h"
@@ -44,7 +45,8 @@ typedef struct {
 } WhichResult;
 
 
-WhichResult which(StrView cmd, char *PATH);
+/* Commands that are not builtins are looked up through the PATH cache */
+WhichResult which(PathCache *path_cache, StrView cmd, char *PATH);
 int builtin_which(Interpreter *interpreter, ArenaLL *ast_nodes);
 int builtin_cd(Interpreter *interpreter, ArenaLL *ast_nodes);
 int builtin_vars(Interpreter *interpreter, ArenaLL *ast_nodes);
@@ -52,6 +54,11 @@ int builtin_exit(Interpreter *interpreter, ArenaLL *ast_nodes);
 int builtin_read(Interpreter *interpreter, ArenaLL *ast_nodes);
 int builtin_dot(Interpreter *interpreter, ArenaLL *ast_nodes);
 int builtin_time(Interpreter *interpreter, ArenaLL *ast_nodes);
+int builtin_hash(Interpreter *interpreter, ArenaLL *ast_nodes);
+int builtin_gc(Interpreter *interpreter, ArenaLL *ast_nodes);
+
+/* Prints GC statistics to stderr if GC_STATS_ENV is set */
+void gc_stats_report_at_exit(Interpreter *interpreter);
 
 
 #endif /* BUILTIN_H */
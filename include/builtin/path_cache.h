@@ -0,0 +1,70 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "nicc/nicc.h"
+#include "options.h"
+
+
+typedef struct {
+	bool found; // false means the command was not found in any directory (negative lookup)
+	size_t dir; // index of the directory the command was found in
+	size_t hits;
+	char path[PROGRAM_PATH_MAX_LEN]; // full path if found, else the command name
+} PathCacheEntry;
+
+typedef struct {
+	char *path;
+	bool exists;
+	struct timespec mtime;
+} PathCacheDir;
+
+/*
+ * Maps command names to the location of the executable in PATH, like the hash table in bash.
+ * Built lazily as commands are looked up. All entries are dropped when PATH differs from the PATH
+ * the cache was built for, or when a directory that was searched has been modified since.
+ */
+typedef struct {
+	HashMap entries; // command name (null terminated) -> PathCacheEntry
+	char *PATH; // copy of the PATH the entries were resolved against, NULL if not built
+	PathCacheDir *dirs;
+	size_t dirs_len;
+} PathCache;
+
+
+void path_cache_init(PathCache *cache);
+void path_cache_free(PathCache *cache);
+/* Drops all entries. The cache is rebuilt on the next lookup */
+void path_cache_clear(PathCache *cache);
+/*
+ * Returns the entry for the command, searching PATH only on a cache miss.
+ * The returned entry is valid until the next call to any path_cache function.
+ */
+PathCacheEntry *path_cache_lookup(PathCache *cache, char *PATH, char *command);
+/*
+ * Writes pointers to every entry into the given array which must have room for at least
+ * cache->entries.len elements. Returns the amount of entries.
+ */
+size_t path_cache_entries(PathCache *cache, PathCacheEntry **entries);
+
+
+#endif /* PATH_CACHE_H */
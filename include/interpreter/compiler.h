@@ -0,0 +1,147 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <stdint.h>
+
+#include "interpreter/ast.h"
+#include "interpreter/scope.h"
+#include "interpreter/str_pool.h"
+#include "interpreter/value/slash_value.h"
+#include "nicc/nicc.h"
+#include "sac/sac.h"
+
+
+/*
+ * X macro for the opcodes.
+ * Each opcode is one 32 bit word in the code followed by zero or more 32 bit operand words.
+ * Variables declared in the chunk are resolved to a (depth, slot) pair at compile time, where
+ * depth is the amount of scopes to walk outwards from the current scope. Variables that can not be
+ * resolved are looked up by name as function scopes enclose the scope of the caller.
+ * The identifiers for the OpCode enum will be OP_`op` where `op` is the X macro param.
+ */
+#define OPCODES                                                                     \
+	X(CONSTANT) /* [const]: push constants[const] */                                \
+	X(NONE) /* push None */                                                         \
+	X(TRUE) /* push true */                                                         \
+	X(FALSE) /* push false */                                                       \
+	X(STR) /* [const]: push the shared str of the literal in constants[const] */    \
+	X(POP) /* pop one value */                                                      \
+	X(POPN) /* [n]: pop n values */                                                 \
+	X(PRINT) /* print and pop top of stack followed by a newline */                 \
+	X(LINE) /* [line]: set the source line used when reporting runtime errors */    \
+	X(GET_VAR) /* [name]: push the value of variable looked up by name */           \
+	X(SET_VAR) /* [name]: pop and assign to existing variable looked up by name */  \
+	X(GET_LOCAL) /* [depth, slot, name]: push the value of a resolved variable */   \
+	X(DEFINE_LOCAL) /* [slot]: pop and define in slot of the current scope */       \
+	X(SET_LOCAL) /* [depth, slot, name]: pop and assign to a resolved variable */   \
+	X(ADD)                                                                          \
+	X(ADD_TMP) /* like ADD, but a concatenated str is put on the tmp arena */       \
+	X(SUB)                                                                          \
+	X(MUL)                                                                          \
+	X(EQ)                                                                           \
+	X(NE)                                                                           \
+	X(GT)                                                                           \
+	X(GE)                                                                           \
+	X(LT)                                                                           \
+	X(LE)                                                                           \
+	X(BINARY) /* [op]: generic binary operator where op is the TokenType */         \
+	X(OR)                                                                           \
+	X(IN)                                                                           \
+	X(RANGE)                                                                        \
+	X(NOT)                                                                          \
+	X(NEGATE)                                                                       \
+	X(TRUTHY) /* replace top of stack with its truthiness as a bool */              \
+	X(SUBSCRIPT)                                                                    \
+	X(SUBSCRIPT_ASSIGN) /* [name, op]: $name[index] op= value */                    \
+	X(LIST) /* [n]: pop n values and push a list containing them */                 \
+	X(TUPLE) /* [n]: pop n values and push a tuple containing them */               \
+	X(MAP) /* [n]: pop n key value pairs and push a map containing them */          \
+	X(CAST) /* [type_name]: cast top of stack to the type with the given name */    \
+	X(CAST_TMP) /* [type_name]: like CAST, but a new str is put on the tmp arena */ \
+	X(TMP_BEGIN) /* push a mark of the tmp arena */                                 \
+	X(TMP_END) /* pop the value above the mark, release to the mark and push it */  \
+	X(EXIT_CODE) /* push true if previous exit code was 0 */                        \
+	X(UNPACK) /* [n]: pop a tuple of size n and push its items */                   \
+	X(ASSERT)                                                                       \
+	X(JUMP) /* [offset]: jump forward */                                            \
+	X(JUMP_IF_FALSE) /* [offset]: pop and jump forward if falsy */                  \
+	X(JUMP_IF_TRUE) /* [offset]: pop and jump forward if truthy */                  \
+	X(LOOP) /* [offset]: jump backward */                                           \
+	X(PUSH_SCOPE) /* [n_slots, names]: push scope with the given slot layout */     \
+	X(POP_SCOPE)                                                                    \
+	X(RESET_SCOPE)                                                                  \
+	X(ITER_INIT) /* prepare the iterable on top of stack for ITER_NEXT */           \
+	X(ITER_NEXT) /* [slot, offset]: set slot to the next item or jump if exhausted */  \
+	X(ITER_END) /* pop the iterator and release the iterable */                     \
+	X(LINE_STREAM) /* [node]: push line_stream_or_capture() of the SubshellExpr */  \
+	X(FUNCTION) /* [node]: push function created from FunctionExpr node */          \
+	X(CALL) /* [argc]: call function below the argc arguments */                    \
+	X(RETURN) /* pop return value and unwind the current frame */                   \
+	X(EVAL_EXPR) /* [node]: evaluate Expr node using the tree-walker */             \
+	X(EXEC_STMT) /* [node]: execute Stmt node using the tree-walker */
+
+#define X(op) OP_##op,
+typedef enum { OPCODES OP_ENUM_COUNT } OpCode;
+#undef X
+
+extern char *op_code_str_map[OP_ENUM_COUNT];
+
+/*
+ * A unit of compiled bytecode.
+ * The code may reference AST nodes directly, so a Chunk must not outlive the AST it was compiled
+ * from.
+ */
+typedef struct slash_chunk_t {
+	uint32_t *code;
+	size_t len;
+	size_t cap;
+	SlashValue *constants; // literals and variable names (as text_lit)
+	size_t constants_len;
+	size_t constants_cap;
+	void **nodes; // AST nodes (Expr or Stmt) that are evaluated by the tree-walker
+	size_t nodes_len;
+	size_t nodes_cap;
+	StrView *slot_names; // names of the slots in each scope pushed by the chunk
+	size_t slot_names_len;
+	size_t slot_names_cap;
+	size_t frame_slots; // slots of the scope the chunk is run in, excluding the global scope
+	size_t frame_names; // index into slot_names where the names of the frame slots begins
+	size_t max_stack; // max amount of values this chunk will push onto the value stack
+} Chunk;
+
+
+void chunk_init(Chunk *chunk);
+void chunk_free(Chunk *chunk);
+/* Moves the contents of the chunk into the arena. The original chunk is freed. */
+Chunk *chunk_move_to_arena(Arena *arena, Chunk *chunk);
+void chunk_disassemble(Chunk *chunk);
+
+/*
+ * Compiles a list of top-level statements that are run in the global scope.
+ * Slots for the variables declared at the top-level are reserved in the global scope.
+ */
+void compile_program(Chunk *chunk, StrPool *str_pool, Scope *globals, ArrayList *statements);
+/*
+ * Compiles the body of a function. The chunk implicitly returns None.
+ * The parameters occupy the first slots of the frame scope.
+ */
+void compile_function(Chunk *chunk, StrPool *str_pool, ArenaLL *params, BlockStmt *body);
+
+
+#endif /* COMPILER_H */
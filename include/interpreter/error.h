@@ -28,16 +28,23 @@
 
 #define RUNTIME_ERROR 1
 
+typedef struct stream_ctx_t StreamCtx; // forward decl
+
 extern jmp_buf runtime_error_jmp;
+/* StreamCtx of the running interpreter, flushed by errors reported without interpreter access */
+extern StreamCtx *runtime_error_stream_ctx;
 
 
 void report_lex_err(Lexer *lexer, bool print_offending, char *msg);
 void report_all_parse_errors(ParseError *head, char *full_input);
 void report_parse_err(ParseError *error, char *full_input);
+/* Writes any output buffered in runtime_error_stream_ctx */
+void runtime_error_flush(void);
 
 #ifdef DEBUG
 #define REPORT_RUNTIME_ERROR(...)                                                               \
 	do {                                                                                        \
+		stream_ctx_flush(&(interpreter)->stream_ctx);                                           \
 		REPORT_IMPL("%s[Slash Runtime Error @ %s:%d]:%s ", ANSI_BOLD_START, __FILE__, __LINE__, \
 					ANSI_BOLD_END);                                                             \
 		REPORT_IMPL(__VA_ARGS__);                                                               \
@@ -48,6 +55,7 @@ void report_parse_err(ParseError *error, char *full_input);
 #else
 #define REPORT_RUNTIME_ERROR(...)                                              \
 	do {                                                                       \
+		stream_ctx_flush(&(interpreter)->stream_ctx);                          \
 		REPORT_IMPL("%s[Slash Runtime Error at line %d]:%s ", ANSI_BOLD_START, \
 					(interpreter)->source_line, ANSI_BOLD_END);                \
 		REPORT_IMPL(__VA_ARGS__);                                              \
@@ -62,6 +70,7 @@ void report_parse_err(ParseError *error, char *full_input);
  */
 #define REPORT_RUNTIME_ERROR_OPAQUE(...)                                            \
 	do {                                                                            \
+		runtime_error_flush();                                                      \
 		REPORT_IMPL("%s[Slash Runtime Error]:%s ", ANSI_BOLD_START, ANSI_BOLD_END); \
 		REPORT_IMPL(__VA_ARGS__);                                                   \
 		REPORT_IMPL("\n");                                                          \
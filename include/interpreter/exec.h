@@ -17,12 +17,31 @@
 #ifndef CORE_EXEC_H
 #define CORE_EXEC_H
 
+#include <stdbool.h>
+#include <sys/types.h>
+
 #include "interpreter/interpreter.h"
 
 
 /*
  * argv must be NULL terminated.
+ * Runs the program to completion and returns its exit code, or 127 if it could not be started.
  */
 int exec_program(StreamCtx *stream_ctx, char **argv);
+/*
+ * Forks and places the child in the process group pgid, or in a new group led by the child if
+ * pgid is 0. If foreground is true the group is also given the controlling terminal.
+ * In the child the stdin and stdout of the StreamCtx are dup'ed into place and the active fds are
+ * closed. Returns 0 in the child and the pid of the child in the parent.
+ */
+pid_t exec_fork_in_group(StreamCtx *stream_ctx, pid_t pgid, bool foreground);
+/* Same as exec_program, but returns the pid of the child without waiting for it */
+pid_t exec_program_async(StreamCtx *stream_ctx, char **argv, pid_t pgid, bool foreground);
+/* Waits for the child and returns its exit code. Killed children get 128 + the signal number */
+int exec_wait(pid_t pid);
+/* True if stdin is a terminal and slash is in its foreground process group */
+bool exec_owns_terminal(void);
+/* Makes pgid the foreground process group of the terminal. Pass getpgrp() to take it back */
+void exec_give_terminal(pid_t pgid);
 
 #endif /* CORE_EXEC_H */
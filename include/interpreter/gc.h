@@ -17,7 +17,9 @@
 #ifndef GC_H
 #define GC_H
 
+#include "interpreter/gc_pool.h"
 #include "nicc/nicc.h"
+#include "sac/sac.h"
 
 
 typedef struct slash_type_info_t SlashTypeInfo; // Forward decl
@@ -25,11 +27,75 @@ typedef struct slash_obj_t SlashObj; // Forward decl
 typedef struct slash_value_t SlashValue; // Forward decl
 typedef struct interpreter_t Interpreter; // Forward decl
 
+/*
+ * The objects managed by the GC are linked through the gc_next field in their header, newest first.
+ * Whether an object is marked is decided by comparing its gc_marked field to mark_epoch. Flipping
+ * the epoch after a major collection unmarks every survivor at once.
+ * Objects allocated since the previous collection are marked when created so they survive the next
+ * collection even if they are not yet reachable. They are always traced, as they may be the only
+ * thing referencing older objects.
+ *
+ * The heap is split in two generations. New objects are young, and a young object that survives
+ * a collection after the one it was created before is promoted to the old generation. A minor
+ * collection only marks and sweeps young objects. The write barrier promotes young objects stored
+ * in old objects, and old objects that may reference young objects are tracked in the remembered
+ * set and traced as roots. A major collection marks and sweeps both generations.
+ *
+ * A major collection marks incrementally. It scans the roots when it begins, and afterwards every
+ * allocation traces mark_step values. Minor collections do not run meanwhile. Objects stored in
+ * containers while marking are marked by the write barrier, so an already traced container never
+ * references an unmarked object. Once there is nothing left to trace, the roots are scanned again
+ * and the young generation is swept.
+ * The old generation is swept lazily, GC_SWEEP_STEP objects per allocation, and the sweep is
+ * finished before the next major collection begins.
+ *
+ * When the heap is at least parallel_mark_min bytes, major collections are not incremental. The
+ * program is paused while mark_threads threads mark, claiming objects by atomically setting
+ * gc_marked.
+ */
 typedef struct {
-	LinkedList gc_objs; // objects managed by the GC
+	SlashObj *objs; // the young generation
+	SlashObj *objs_traced; // first young object that existed at the end of the previous collection
+	SlashObj *old_objs; // the old generation
+	size_t objs_len;
+	bool mark_epoch;
+	bool minor; // a minor collection is running
+	bool marking; // an incremental major collection is marking
+	SlashObj **sweep_link; // link to the next old object to sweep, NULL if the sweep is done
+	size_t mark_step; // values traced per allocation while marking, 0 means no incremental marking
+	size_t mark_threads; // threads marking a stop-the-world major collection, 1 is not parallel
+	size_t parallel_mark_min; // heap size in bytes from which major collections mark in parallel
+	bool mark_parallel; // marking is done by several threads, gc_marked must be set atomically
+	Arena *tmp_arena; // if not NULL, allocations are put here and not managed, see gc_tmp_begin()
 	ArrayList gray_stack;
+	ArrayList remembered; // old objects that may reference young objects
+	ArrayList new_containers; // lists, tuples and maps allocated since the previous collection
+	GCPool pool; // where all memory managed by the GC is allocated from
 	size_t bytes_managing;
-	size_t next_run; // how many bytes allocated until we run the GC again
+	size_t bytes_since_run; // bytes allocated since the previous collection
+	size_t next_run; // how many bytes allocated until we run a major collection again
+	double heap_grow_factor; // next_run is the heap left after a major collection times this
+	size_t min_run; // next_run is never less than this
+	size_t max_heap; // a full collection is forced before bytes_managing exceeds this, 0 if unset
+
+	/* adaptive heap growth, see gc_adapt_grow_factor() */
+	bool adaptive; // heap_grow_factor is adjusted after every major collection
+	double overhead_target; // wanted time spent collecting relative to time spent running
+	double overhead; // major collection time relative to mutator time over the latest cycle
+	double survival; // fraction of the heap that survived the latest major collection
+	size_t bytes_before_major;
+	double cycle_start; // when the previous major collection finished
+	double cycle_pause_start; // pause_total at cycle_start
+	double cycle_minor_pause_start; // minor_pause_total at cycle_start
+
+	/* statistics */
+	size_t minor_runs;
+	size_t major_runs;
+	double pause_total; // seconds spent collecting
+	double pause_max; // longest time spent collecting during a single allocation
+	double minor_pause_total; // part of pause_total spent on minor collections
+	size_t bytes_freed_minor; // by the latest minor collection
+	size_t bytes_freed_major; // by the latest major collection, including its lazy sweep
 
 	ArrayList shadow_stack; // list of objects that are always always marked during gc run.
 	unsigned int barrier; // value > 0 means we are in a GC barrier. Value signifies barrier depth.
@@ -37,17 +103,60 @@ typedef struct {
 } GC;
 
 
+typedef struct {
+	SlashTypeInfo *T;
+	size_t count;
+} GCTypeCount;
+
+
 void gc_ctx_init(GC *gc);
 void gc_ctx_free(GC *gc);
 void *gc_alloc(Interpreter *interpreter, size_t size);
 void *gc_realloc(Interpreter *interpreter, void *p, size_t old_size, size_t new_size);
 void gc_free(Interpreter *interpreter, void *data, size_t size_freed);
 SlashObj *gc_new_T(Interpreter *interpreter, SlashTypeInfo *T);
+/* Like gc_new_T(), for objects with a variable size of at least T->obj_size bytes */
+SlashObj *gc_new_T_sized(Interpreter *interpreter, SlashTypeInfo *T, size_t size);
 /*
- * Runs the garbage collector.
+ * Runs a major collection, or finishes the incremental one that is running.
  * Finds all unreachable objects and frees them.
  */
 void gc_run(Interpreter *interpreter);
+/*
+ * Same as gc_run(), except unreachable old objects are left for later allocations to sweep.
+ */
+void gc_run_major(Interpreter *interpreter);
+/*
+ * Runs a minor collection.
+ * Frees unreachable young objects and promotes the ones that have survived long enough.
+ */
+void gc_run_minor(Interpreter *interpreter);
+/*
+ * Must be called after value is stored in container.
+ * Marks value if a major collection is marking.
+ * If container is old and value is young, value is promoted so minor collections do not free it.
+ */
+void gc_write_barrier(GC *gc, SlashObj *container, SlashValue value);
+/*
+ * Until gc_tmp_end(), gc_alloc() and gc_new_T() allocate on the arena and the objects are not
+ * managed by the GC. Only for allocating values that provably do not outlive the arena, such as the
+ * str returned by a to_str trait that is only read.
+ */
+void gc_tmp_begin(GC *gc, Arena *arena);
+void gc_tmp_end(GC *gc);
+/*
+ * Sets the heap size at which the next major collection starts from heap_grow_factor and min_run.
+ */
+void gc_set_next_run(GC *gc);
+/*
+ * Sets how many threads mark large heaps, at least one and at most GC_MARK_THREADS_MAX.
+ */
+void gc_set_mark_threads(GC *gc, size_t n);
+/*
+ * Counts the objects managed by the GC per type.
+ * Returns how many entries of counts were filled, which is at most max.
+ */
+size_t gc_count_objs(Interpreter *interpreter, GCTypeCount *counts, size_t max);
 /*
  * Free all uncollected objects regardless of if they are reachable or not.
  * Used on exit.
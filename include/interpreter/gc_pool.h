@@ -0,0 +1,74 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef GC_POOL_H
+#define GC_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "options.h"
+
+
+#define GC_POOL_N_CLASSES 15
+
+/*
+ * A slab holds cells of one size class. Slabs are aligned to their size, so the slab a cell
+ * belongs to is found by masking the address of the cell.
+ */
+typedef struct gc_slab_t {
+	struct gc_slab_t *next;
+	struct gc_slab_t *prev;
+	void *free_cells; // freed cells, linked through their first word
+	char *fresh; // cells from here to the end of the slab have never been handed out
+	uint32_t used;
+	uint32_t cells;
+	uint8_t size_class;
+} GCSlab;
+
+typedef struct {
+	GCSlab *partial; // slabs with at least one free cell
+	GCSlab *full;
+	size_t slabs;
+	size_t cells_used;
+} GCSizeClass;
+
+/*
+ * Segregated fit allocator for the memory managed by the GC.
+ * Allocations up to GC_POOL_MAX_CELL bytes are rounded up to the nearest size class and served from
+ * the slabs of that class. Larger allocations are passed on to malloc.
+ * Since the GC always knows the size of what it frees, cells carry no header.
+ */
+typedef struct {
+	GCSizeClass classes[GC_POOL_N_CLASSES];
+	uint8_t class_of[GC_POOL_MAX_CELL / 16 + 1]; // size class of each size rounded up to 16
+} GCPool;
+
+
+void gc_pool_init(GCPool *pool);
+/* Releases every slab */
+void gc_pool_free(GCPool *pool);
+void *gc_pool_alloc(GCPool *pool, size_t size);
+void *gc_pool_realloc(GCPool *pool, void *p, size_t old_size, size_t new_size);
+/* size must be the size p was allocated or last reallocated with */
+void gc_pool_dealloc(GCPool *pool, void *p, size_t size);
+/* Gives slabs that have no cells in use back to the system, keeping one per class for reuse */
+void gc_pool_release_empty(GCPool *pool);
+/* Prints the amount of slabs of each size class and how much of them is in use */
+void gc_pool_report(GCPool *pool, FILE *stream);
+
+#endif /* GC_POOL_H */
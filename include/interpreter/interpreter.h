@@ -19,11 +19,15 @@
 
 #include <stdio.h>
 
+#include "builtin/path_cache.h"
 #include "interpreter/ast.h"
 #include "interpreter/gc.h"
 #include "interpreter/scope.h"
+#include "interpreter/str_pool.h"
+#include "interpreter/vm.h"
 #include "lib/arena_ll.h"
 #include "nicc/nicc.h"
+#include "options.h"
 #include "sac/sac.h"
 
 
@@ -42,47 +46,78 @@ typedef enum {
 
 typedef struct {
 	ExecResultType type;
-	Expr *return_expr;
+	SlashValue return_value; // evaluated where the return is, as the scopes are left after it
 } ExecResult;
 
-#define EXEC_NORMAL                            \
-	(ExecResult)                               \
-	{                                          \
-		.type = RT_NORMAL, .return_expr = NULL \
+#define EXEC_NORMAL           \
+	(ExecResult)              \
+	{                         \
+		.type = RT_NORMAL     \
 	}
 
-#define SLASH_PRINT(__stream_ctx, ...) dprintf((__stream_ctx)->out_fd, __VA_ARGS__)
-#define SLASH_PRINT_ERR(__stream_ctx, ...) dprintf((__stream_ctx)->err_fd, __VA_ARGS__)
+#define SLASH_PRINT(__stream_ctx, ...) stream_ctx_printf((__stream_ctx), __VA_ARGS__)
+/* errors are not buffered, but anything printed before them must be written first */
+#define SLASH_PRINT_ERR(__stream_ctx, ...)            \
+	do {                                              \
+		stream_ctx_flush((__stream_ctx));             \
+		dprintf((__stream_ctx)->err_fd, __VA_ARGS__); \
+	} while (0)
 
 
-typedef struct {
+/*
+ * Output printed by slash itself is buffered and written to the out fd in large chunks.
+ * The buffer holds output for one fd at a time. It is flushed when printing to a different out fd,
+ * when full, before a process is started, once a command or subshell is done, and on exit or error.
+ */
+typedef struct stream_ctx_t {
 	int in_fd; // defaults to fileno(STDIN)
 	int out_fd; // defaults to fileno(STDOUT)
 	int err_fd; // defaults to fileno(STDERR)
 	ArrayList active_fds; // list/stack of open file descriptors that need to be closed on fork()
+	int buf_fd; // fd the buffered output belongs to
+	size_t buf_len;
+	char buf[STREAM_BUF_SIZE];
 } StreamCtx;
 
+void stream_ctx_printf(StreamCtx *stream_ctx, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+/* Writes any buffered output */
+void stream_ctx_flush(StreamCtx *stream_ctx);
+
 typedef struct interpreter_t {
 	Arena arena;
+	Arena tmp_arena; // values that provably do not escape the expression or command creating them
 	Scope globals;
 	Scope *scope;
 	GC gc;
 	StreamCtx stream_ctx;
 	HashMap type_register;
+	StrPool str_pool; // str literals, shared by every evaluation of them
+	ArrayList subshell_captures; // SubshellCapture * of subshells being evaluated, innermost last
 	int prev_exit_code;
 	ExecResult exec_res_ctx;
 	int source_line; // file number we are currently interpreting
+	VM vm;
+	PathCache path_cache; // locations of the programs in PATH that have been executed
+	bool tree_walk; // if true then statements are interpreted by walking the AST, not by the VM
 } Interpreter;
 
 
 void interpreter_init(Interpreter *interpreter, int argc, char **argv);
 void interpreter_free(Interpreter *interpreter);
 int interpreter_run(Interpreter *interpreter, ArrayList *statements);
-int interpret(ArrayList *statements, int argc, char **argv);
+int interpret(ArrayList *statements, int argc, char **argv, bool tree_walk, size_t max_heap);
 
+void set_exit_code(Interpreter *interpreter, int exit_code);
 void exec_cmd(Interpreter *interpreter, CmdStmt *stmt);
 void ast_ll_to_argv(Interpreter *interpreter, ArenaLL *ast_nodes, SlashValue *result);
 void exec_program_stub(Interpreter *interpreter, char *program_path, ArenaLL *ast_nodes);
 
+/* Tree-walker entry points. Used by the VM for nodes it does not compile */
+SlashValue tree_walk_eval(Interpreter *interpreter, Expr *expr);
+void tree_walk_exec(Interpreter *interpreter, Stmt *stmt);
+SlashValue eval_binary_operators(Interpreter *interpreter, SlashValue left, SlashValue right,
+								 TokenType op);
+
 
 #endif /* INTERPRETER_H */
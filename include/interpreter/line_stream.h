@@ -0,0 +1,73 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef LINE_STREAM_H
+#define LINE_STREAM_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "interpreter/ast.h"
+#include "interpreter/interpreter.h"
+#include "interpreter/value/slash_value.h"
+
+
+/*
+ * Iterates over the output of a subshell one item at a time while the subshell is running.
+ * Used by `loop x in (cmd)` so the output never has to be held in memory all at once.
+ * The output is split on any of the separators in the same way as iterating over the captured
+ * str would split it, so the two are interchangeable.
+ */
+typedef struct {
+	SlashObj obj;
+	pid_t pid; // the forked slash running the subshell, -1 once waited for
+	int fd; // read end of the pipe, -1 once closed
+	bool eof;
+	char *buf; // bytes read but not yet handed out
+	size_t start; // start of the item currently being scanned
+	size_t len;
+	size_t cap;
+	char *separators; // copy of $IFS when the stream was created
+} SlashLineStream;
+
+extern SlashTypeInfo line_stream_type_info;
+
+#define IS_LINE_STREAM(value__) IS_OBJ_T((value__), &line_stream_type_info)
+#define AS_LINE_STREAM(value__) ((SlashLineStream *)AS_OBJ((value__)))
+
+
+/*
+ * Returns what `loop x in (cmd)` iterates over.
+ * The subshell is run in a fork of slash and its output is streamed, unless its last command is a
+ * builtin. The builtin has to run in slash itself for its side effects (e.g. `cd` or `read`) to be
+ * seen by the script, so such a subshell is captured into a str like any other subshell.
+ * What a streamed subshell can not pass back to the script is therefore limited to $PIPESTATUS.
+ */
+SlashValue line_stream_or_capture(Interpreter *interpreter, SubshellExpr *expr);
+/* Starts the subshell in a fork and returns the stream reading its output */
+SlashLineStream *line_stream_new(Interpreter *interpreter, SubshellExpr *expr);
+/* Returns false once the output is exhausted. Blocks until the next item is complete */
+bool line_stream_next(Interpreter *interpreter, SlashLineStream *stream, SlashValue *next);
+/*
+ * Closes the read end and waits for the subshell, setting its exit code as '$?'.
+ * Safe to call multiple times. A subshell that is still writing is terminated by SIGPIPE.
+ */
+void line_stream_close(Interpreter *interpreter, SlashLineStream *stream);
+/* Releases everything owned by the stream. Called by the GC */
+void line_stream_free(Interpreter *interpreter, SlashLineStream *stream);
+
+
+#endif /* LINE_STREAM_H */
@@ -17,6 +17,8 @@
 #ifndef SCOPE_H
 #define SCOPE_H
 
+#include <sys/types.h>
+
 #include "lib/str_view.h"
 #include "nicc/nicc.h"
 #include "sac/sac.h"
@@ -29,7 +31,17 @@ struct scope_t {
 	Scope *enclosing; // if NULL then there is no enclosing scope and is the global scope
 	size_t depth; // the amount of enclosing scopes
 	ArenaTmp arena_tmp; // arena to put any temporary data on
-	HashMap values; // key: StrView, value: SlashValue (actual objects, not pointers)
+	/*
+	 * Variables are stored in slots. The first slots are reserved when the scope is created and
+	 * are accessed directly by their slot index by the VM. Variables defined by name that don't
+	 * have a reserved slot are appended after them.
+	 */
+	SlashValue *values; // slot -> value. Slot is not defined if the value is undefined
+	StrView *names; // slot -> name
+	size_t len; // slots in use, including reserved slots
+	size_t cap;
+	bool owns_slots; // true if values and names are malloced and not on the arena
+	HashMap *index; // name -> slot. Only kept for the global scope as it may grow large.
 };
 
 typedef struct {
@@ -39,21 +51,33 @@ typedef struct {
 
 
 void scope_init(Scope *scope, Scope *enclosing);
+/*
+ * Inits the scope with n_reserved slots whose names are given by reserved_names.
+ * The reserved names must outlive the scope.
+ */
+void scope_init_slots(Scope *scope, Scope *enclosing, StrView *reserved_names, size_t n_reserved);
 void scope_destroy(Scope *scope);
+/*
+ * Undefines every variable in the scope. Slots and their names are kept, so a loop that resets its
+ * scope every iteration finds the same slots again without allocating.
+ */
 void scope_reset(Scope *scope);
 void *scope_alloc(Scope *scope, size_t size);
 void scope_init_globals(Scope *scope, Arena *arena, int argc, char **argv);
+/* returns the slot of the variable or -1 if the scope has no slot with the given name */
+ssize_t scope_find_slot(Scope *scope, StrView *key);
+/* returns the slot of the variable, appending an undefined slot if the scope has none */
+size_t scope_reserve_slot(Scope *scope, StrView *key);
 
 /*
- * copies the SlashValue object into the hashmap
+ * copies the SlashValue object into the slot of the variable
  * if value is NULL then the variable is defined as SLASH_NONE
  */
 void var_define(Scope *scope, StrView *key, SlashValue *value);
 
 /*
  * assigns the value to the variable whose key/name is var_name.
- * transfers the ownership of the reference value of the variable if needed.
- * if not it calls var_assign_simple.
+ * defines the variable in the given scope if it does not exist.
  */
 void var_assign(StrView *var_name, Scope *scope, SlashValue *value);
 
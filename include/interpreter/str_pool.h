@@ -0,0 +1,63 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef STR_POOL_H
+#define STR_POOL_H
+
+#include <stdbool.h>
+
+#include "interpreter/value/slash_value.h"
+#include "lib/str_view.h"
+#include "nicc/nicc.h"
+
+
+typedef struct interpreter_t Interpreter; // Forward decl
+typedef struct slash_str_t SlashStr; // Forward decl
+
+typedef struct {
+	StrView view; // the text of the literal. Chunks reference the entry through a text_lit of it
+	SlashStr *str; // the shared str, NULL until the literal is first evaluated
+	char text[];
+} StrPoolEntry;
+
+/*
+ * Str literals are materialized once and shared by every evaluation of a literal with the same
+ * text, so evaluating a literal does not allocate. The shared strs are GC roots for as long as the
+ * interpreter lives, which bounds the pool by the distinct literals in the source.
+ * A shared str must never be modified, so it is copied when it is bound to a variable, an argument
+ * or an item of a container, see str_pool_unshare(). Every binding then owns its str like a str
+ * created in any other way, and binding that str again aliases it.
+ */
+typedef struct {
+	HashMap entries; // text -> StrPoolEntry
+	ArrayList all; // StrPoolEntry *, in the order they were added
+} StrPool;
+
+
+void str_pool_init(StrPool *pool);
+void str_pool_free(StrPool *pool);
+/* Returns the entry for the text, adding it if needed. Entries live as long as the pool */
+StrPoolEntry *str_pool_intern(StrPool *pool, StrView *view);
+/* Returns the shared str of the entry, creating it the first time */
+SlashStr *str_pool_get(Interpreter *interpreter, StrPoolEntry *entry);
+/*
+ * Returns the value to bind. A shared str is replaced by a copy that can be modified.
+ * The copy is not reachable until it is stored, so the caller must store it before allocating.
+ */
+SlashValue str_pool_unshare(Interpreter *interpreter, SlashValue value);
+
+
+#endif /* STR_POOL_H */
@@ -54,7 +54,7 @@
 typedef struct {
 	SlashValue key;
 	SlashValue value;
-	uint8_t hash_extra; // used for faster comparison
+	uint32_t hash; // compared before the keys, and used to move the entry when the map grows
 	bool is_occupied;
 } SlashMapEntry;
 
@@ -19,23 +19,59 @@
 #endif /* SLASH_STR_IMPL_H */
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "interpreter/interpreter.h"
 #include "interpreter/value/slash_value.h"
 
 
+/*
+ * Short strs hold their characters right after the header, so creating one is a single allocation.
+ * Longer strs instead live in a buffer that may be shared by several strs. A substr of such a str
+ * references the buffer of the str rather than copying the characters out of it, which keeps the
+ * whole buffer alive for as long as the substr is.
+ * Appending to a str that ends where the used part of its buffer ends writes the new characters
+ * into the spare capacity of the buffer, and the result shares the buffer with the str appended to.
+ * The characters of a str are never changed by this, but the str is no longer null terminated.
+ * Buffers are freed when the last str referencing them is swept.
+ */
 typedef struct {
+	size_t refs; // managed strs referencing the buffer
+	size_t cap; // bytes allocated for data
+	size_t used; // bytes of data in use. Only a str ending here can be appended to in place
+	char data[];
+} SlashStrBuf;
+
+typedef struct slash_str_t {
 	SlashObj obj;
-	char *str; // Null terminated
+	char *str; // Null terminated unless a substr or appended to, slash_str_cstr() ensures it
 	size_t len; // Length of string: does not includes null terminator. So "hi" has length 2
+	SlashStrBuf *buf; // buffer str points into, NULL if the characters are not owned by a buffer
+	uint32_t hash; // 0 until computed by str_hash(). Reset when the characters are modified
+	bool literal; // shared by every evaluation of a literal and never modified. See str_pool.h
+	char data[]; // characters of a str that is not in a buffer, allocated together with the str
 } SlashStr;
 
 
 /* functions */
-void slash_str_init_from_view(Interpreter *interpreter, SlashStr *str, StrView *view);
-void slash_str_init_from_slice(Interpreter *interpreter, SlashStr *str, char *cstr, size_t size);
-void slash_str_init_from_concat(Interpreter *interpreter, SlashStr *str, SlashStr *a, SlashStr *b);
+/* A str shorter than STR_INLINE_MAX holds its characters after the header */
+SlashStr *slash_str_new_from_view(Interpreter *interpreter, StrView *view);
+SlashStr *slash_str_new_from_slice(Interpreter *interpreter, char *cstr, size_t size);
+/* Short results are held after the header, longer ones in a buffer that can be appended to */
+SlashStr *slash_str_new_from_concat(Interpreter *interpreter, SlashStr *a, SlashStr *b);
+/* The len characters of str from start, sharing the buffer of str when it has one */
+SlashStr *slash_str_new_substr(Interpreter *interpreter, SlashStr *str, size_t start, size_t len);
+/* Takes ownership of a malloc'ed buffer holding len bytes */
+SlashStr *slash_str_new_from_malloced(Interpreter *interpreter, char *buf, size_t len);
 void slash_str_init_from_alloced_cstr(SlashStr *str, char *cstr);
+/* Releases the buffer of str. Called when str is swept */
+void slash_str_free(Interpreter *interpreter, SlashStr *str);
+/* Bytes allocated for the str object, including characters held after the header */
+size_t slash_str_obj_size(SlashStr *str);
+/* Returns the characters of str null terminated, copying them to a buffer of its own if needed */
+char *slash_str_cstr(Interpreter *interpreter, SlashStr *str);
+/* Gives str a buffer no other str references, so its characters can be modified */
+void slash_str_make_private(Interpreter *interpreter, SlashStr *str);
 SlashList *slash_str_split(Interpreter *interpreter, SlashStr *str, char *separator,
 						   bool split_any);
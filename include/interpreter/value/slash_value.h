@@ -18,24 +18,22 @@
 #define SLASH_VALUE_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "interpreter/value/type_funcs.h"
 #include "lib/arena_ll.h"
 #include "sac/sac.h"
 
 
-/* The Range type */
-typedef struct {
-	int32_t start;
-	int32_t end;
-} SlashRange;
-
 typedef struct slash_block_stmt_t BlockStmt; // Forward decl.
+typedef struct slash_chunk_t Chunk; // Forward decl.
 
-/* The Function type */
+/* The Function type. Lives on the arena of the scope it was defined in */
 typedef struct {
 	ArenaLL params;
 	BlockStmt *body;
+	Chunk *chunk; // compiled body, NULL until compiled
 } SlashFunction;
 
 
@@ -44,8 +42,11 @@ typedef struct slash_type_info_t SlashTypeInfo;
 /* The "head" of each Object type */
 typedef struct slash_obj_t {
 	SlashTypeInfo *T; // TODO: not ideal ...
-	bool gc_marked;
+	struct slash_obj_t *gc_next; // next object in the list of objects managed by the GC
+	bool gc_marked; // the object is marked when this equals the mark epoch of the GC
 	bool gc_managed;
+	bool gc_old; // the object is in the old generation
+	uint8_t gc_remembered; // collections left before the object leaves the remembered set
 } SlashObj;
 
 /*
@@ -55,6 +56,12 @@ typedef struct slash_obj_t {
  *
  * SlashMap defined in ./slash_map.h and SlashList in ./slash_list.h
  */
+typedef struct {
+	SlashObj obj;
+	int32_t start;
+	int32_t end;
+} SlashRange;
+
 typedef struct {
 	SlashObj obj;
 	size_t len;
@@ -101,18 +108,30 @@ typedef struct slash_type_info_t {
 	size_t obj_size; // Size of the object in bytes
 } SlashTypeInfo;
 
+/*
+ * A NaN-boxed value.
+ * Any bit pattern that is not a quiet NaN with QNAN_BITS set is a num. Otherwise:
+ *  - If the sign bit is set, the low 48 bits is a pointer to a SlashObj which holds the type info.
+ *  - Else the two bits above the 48 bit payload is a tag. Tag 0 is for singletons where the
+ *    payload identifies the value, while text_lit and function store a pointer in the payload.
+ */
 typedef struct slash_value_t {
-	SlashTypeInfo *T;
-	union {
-		bool boolean;
-		double num;
-		SlashRange range;
-		StrView text_lit;
-		SlashFunction function;
-		SlashObj *obj;
-	};
+	uint64_t bits;
 } SlashValue;
 
+_Static_assert(sizeof(SlashValue) == 8, "SlashValue must fit in a machine word");
+
+#define SIGN_BIT ((uint64_t)0x8000000000000000)
+#define QNAN_BITS ((uint64_t)0x7ffc000000000000)
+#define PAYLOAD_MASK ((uint64_t)0x0000ffffffffffff)
+#define TAG_MASK ((uint64_t)0x0003000000000000)
+#define TAG_TEXT_LIT ((uint64_t)0x0001000000000000)
+#define TAG_FUNCTION ((uint64_t)0x0002000000000000)
+#define UNDEFINED_BITS (QNAN_BITS | 0)
+#define NONE_BITS (QNAN_BITS | 1)
+#define FALSE_BITS (QNAN_BITS | 2)
+#define TRUE_BITS (QNAN_BITS | 3)
+
 
 extern SlashTypeInfo bool_type_info;
 extern SlashTypeInfo num_type_info;
@@ -127,28 +146,94 @@ extern SlashTypeInfo none_type_info;
 
 extern SlashValue NoneSingleton;
 
-#define IS_BOOL(value__) ((value__).T == &bool_type_info)
-#define IS_NUM(value__) ((value__).T == &num_type_info)
-#define IS_RANGE(value__) ((value__).T == &range_type_info)
-#define IS_TEXT_LIT(value__) ((value__).T == &text_lit_type_info)
-#define IS_FUNCTION(value__) ((value__).T == &function_type_info)
-#define IS_MAP(value__) ((value__).T == &map_type_info)
-#define IS_LIST(value__) ((value__).T == &list_type_info)
-#define IS_TUPLE(value__) ((value__).T == &tuple_type_info)
-#define IS_STR(value__) ((value__).T == &str_type_info)
-#define IS_NONE(value__) ((value__).T == &none_type_info)
-#define IS_OBJ(value__) \
-	(IS_MAP((value__)) || IS_LIST((value__)) || IS_TUPLE((value__)) || IS_STR((value__)))
-
-#define AS_MAP(value__) ((SlashMap *)(value__).obj)
-#define AS_LIST(value__) ((SlashList *)(value__).obj)
-#define AS_TUPLE(value__) ((SlashTuple *)(value__).obj)
-#define AS_STR(value__) ((SlashStr *)(value__).obj)
-#define AS_VALUE(obj__) ((SlashValue){ .T = ((SlashObj *)(obj__))->T, .obj = (SlashObj *)(obj__) })
-
-#define TYPE_EQ(a, b) ((a).T == (b).T)
-#define NUM_IS_INT(value_num__) ((value_num__).num == (int)(value_num__).num)
-
+#define IS_NUM(value__) (((value__).bits & QNAN_BITS) != QNAN_BITS)
+#define IS_OBJ(value__) (((value__).bits & (SIGN_BIT | QNAN_BITS)) == (SIGN_BIT | QNAN_BITS))
+#define IS_OBJ_T(value__, T__) (IS_OBJ((value__)) && AS_OBJ((value__))->T == (T__))
+#define IS_BOOL(value__) (((value__).bits | 1) == TRUE_BITS)
+#define IS_NONE(value__) ((value__).bits == NONE_BITS)
+#define IS_UNDEFINED(value__) ((value__).bits == UNDEFINED_BITS)
+#define IS_TEXT_LIT(value__) \
+	(((value__).bits & (SIGN_BIT | QNAN_BITS | TAG_MASK)) == (QNAN_BITS | TAG_TEXT_LIT))
+#define IS_FUNCTION(value__) \
+	(((value__).bits & (SIGN_BIT | QNAN_BITS | TAG_MASK)) == (QNAN_BITS | TAG_FUNCTION))
+#define IS_RANGE(value__) IS_OBJ_T((value__), &range_type_info)
+#define IS_MAP(value__) IS_OBJ_T((value__), &map_type_info)
+#define IS_LIST(value__) IS_OBJ_T((value__), &list_type_info)
+#define IS_TUPLE(value__) IS_OBJ_T((value__), &tuple_type_info)
+#define IS_STR(value__) IS_OBJ_T((value__), &str_type_info)
+
+#define AS_NUM(value__) slash_value_as_num((value__))
+#define AS_BOOL(value__) ((value__).bits == TRUE_BITS)
+#define AS_OBJ(value__) ((SlashObj *)(uintptr_t)((value__).bits & PAYLOAD_MASK))
+#define AS_TEXT_LIT(value__) ((StrView *)(uintptr_t)((value__).bits & PAYLOAD_MASK))
+#define AS_FUNCTION(value__) ((SlashFunction *)(uintptr_t)((value__).bits & PAYLOAD_MASK))
+#define AS_RANGE(value__) ((SlashRange *)AS_OBJ((value__)))
+#define AS_MAP(value__) ((SlashMap *)AS_OBJ((value__)))
+#define AS_LIST(value__) ((SlashList *)AS_OBJ((value__)))
+#define AS_TUPLE(value__) ((SlashTuple *)AS_OBJ((value__)))
+#define AS_STR(value__) ((SlashStr *)AS_OBJ((value__)))
+#define AS_VALUE(obj__) ((SlashValue){ .bits = SIGN_BIT | QNAN_BITS | (uintptr_t)(obj__) })
+
+#define NUM_VAL(num__) slash_value_from_num((num__))
+#define BOOL_VAL(boolean__) ((SlashValue){ .bits = (boolean__) ? TRUE_BITS : FALSE_BITS })
+#define TEXT_LIT_VAL(view__) \
+	((SlashValue){ .bits = QNAN_BITS | TAG_TEXT_LIT | (uintptr_t)(view__) })
+#define FUNCTION_VAL(function__) \
+	((SlashValue){ .bits = QNAN_BITS | TAG_FUNCTION | (uintptr_t)(function__) })
+#define UNDEFINED_VAL ((SlashValue){ .bits = UNDEFINED_BITS })
+
+#define TYPE_OF(value__) slash_value_type((value__))
+#define TYPE_EQ(a, b) (TYPE_OF((a)) == TYPE_OF((b)))
+#define NUM_IS_INT(value_num__) (AS_NUM((value_num__)) == (int)AS_NUM((value_num__)))
+
+
+static inline double slash_value_as_num(SlashValue value)
+{
+	double num;
+	memcpy(&num, &value.bits, sizeof(double));
+	return num;
+}
+
+static inline SlashValue slash_value_from_num(double num)
+{
+	SlashValue value;
+	/* canonicalize NaN so it can never be mistaken for a boxed value */
+	if (num != num)
+		value.bits = (uint64_t)0x7ff8000000000000;
+	else
+		memcpy(&value.bits, &num, sizeof(double));
+	return value;
+}
+
+/* Returns the type info of the value. NULL if the value is undefined */
+static inline SlashTypeInfo *slash_value_type(SlashValue value)
+{
+	if (IS_NUM(value))
+		return &num_type_info;
+	if (IS_OBJ(value))
+		return AS_OBJ(value)->T;
+	switch (value.bits & TAG_MASK) {
+	case TAG_TEXT_LIT:
+		return &text_lit_type_info;
+	case TAG_FUNCTION:
+		return &function_type_info;
+	default:
+		break;
+	}
+	switch (value.bits) {
+	case NONE_BITS:
+		return &none_type_info;
+	case FALSE_BITS:
+	case TRUE_BITS:
+		return &bool_type_info;
+	default:
+		return NULL;
+	}
+}
+
+
+/* Range functions */
+SlashValue slash_range_new(Interpreter *interpreter, int32_t start, int32_t end);
 
 /* Tuple functions */
 void slash_tuple_init(Interpreter *interpreter, SlashTuple *tuple, size_t size);
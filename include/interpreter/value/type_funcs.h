@@ -22,7 +22,7 @@
 
 #define VERIFY_TRAIT_IMPL(trait_func_name, value, ...) \
 	do {                                               \
-		if ((value).T->trait_func_name == NULL)        \
+		if (TYPE_OF((value))->trait_func_name == NULL)  \
 			REPORT_RUNTIME_ERROR_OPAQUE(__VA_ARGS__);  \
 	} while (0);
 
@@ -0,0 +1,48 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef VM_H
+#define VM_H
+
+#include "interpreter/compiler.h"
+#include "interpreter/value/slash_value.h"
+
+
+typedef struct interpreter_t Interpreter; // Forward decl
+
+/*
+ * The value stack shared by all frames.
+ * Every value between stack and sp is a GC root.
+ */
+typedef struct {
+	SlashValue *stack;
+	SlashValue *sp; // points to the next free slot
+	SlashValue *stack_end;
+} VM;
+
+
+void vm_init(VM *vm);
+void vm_free(VM *vm);
+/*
+ * Executes the chunk in the current scope of the interpreter and returns the value it returned.
+ * Re-entrant: each function call runs in its own invocation.
+ */
+SlashValue vm_run(Interpreter *interpreter, Chunk *chunk);
+/* Pops every value above sp, stopping the subshells of the loops over line streams it leaves */
+void vm_unwind(Interpreter *interpreter, SlashValue *sp);
+
+
+#endif /* VM_H */
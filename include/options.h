@@ -39,11 +39,34 @@
 #define MAX_PARSE_ERRORS 64
 
 /* GC options */
-#define GC_HEAP_GROW_FACTOR 2
-#define GC_MIN_RUN (2 << 24) // ̃~32mb
+#define GC_HEAP_GROW_FACTOR 2 // Default, can be changed at runtime with `gc -g`
+#define GC_MIN_RUN (2 << 24) // ̃~32mb. Default, can be changed at runtime with `gc -m`
+#define GC_OVERHEAD_TARGET 0.05 // Wanted GC time relative to mutator time. Grow factor adapts to it
+#define GC_GROW_FACTOR_MIN 1.25 // The adaptive grow factor stays within these bounds
+#define GC_GROW_FACTOR_MAX 8
+#define GC_HIGH_SURVIVAL 0.9 // Major collections where more survived do not shrink the grow factor
+#define GC_NURSERY_SIZE (1 << 22) // Bytes allocated between minor collections
+#define GC_STRESS_MAJOR_EVERY 8 // With DEBUG_STRESS_GC, every nth collection is a major one
+#define GC_MARK_STEP 4096 // Values traced per allocation during a major collection. 0 disables
+#define GC_MARK_STEP_ENV "SLASH_GC_MARK_STEP" // Environment variable overriding GC_MARK_STEP
+#define GC_MARK_THREADS 4 // Threads marking large heaps, at most the number of CPUs. 1 disables
+#define GC_MARK_THREADS_ENV "SLASH_GC_MARK_THREADS" // Environment variable overriding it
+#define GC_MARK_THREADS_MAX 64 // Most threads marking, also when set with gc -t
+#define GC_PARALLEL_MARK_MIN (1 << 26) // ~64mb. Major collections of larger heaps mark in parallel
+#define GC_MARK_SHARE_MIN 64 // Gray objects a parallel marker keeps before sharing with idle ones
+#define GC_SWEEP_STEP 256 // Old objects swept per allocation after a major collection
+#define GC_STATS_ENV "SLASH_GC_STATS" // If set, GC statistics are printed to stderr on exit
+#define GC_POOL_SLAB_SIZE (1 << 16) // Bytes per slab, slabs are aligned to this
+#define GC_POOL_MAX_CELL 1024 // Larger allocations are passed on to malloc
+
+/* VM options */
+#define VM_STACK_MAX (1 << 14) // Max values on the value stack
 
 /* Misc. */
 #define PROGRAM_PATH_MAX_LEN 512
+#define SUBSHELL_READ_SIZE 4096 // Min bytes read at a time when capturing the output of a subshell
+#define STREAM_BUF_SIZE 8192 // Bytes of output buffered before it is written to the out fd
+#define STR_INLINE_MAX 64 // Shorter strs follow the str header, longer ones get a shareable buffer
 
 
 /* Maintenance */
@@ -37,8 +37,8 @@ int builtin_cd(Interpreter *interpreter, ArenaLL *ast_nodes)
 	ast_ll_to_argv(interpreter, ast_nodes, argv);
 
 	SlashValue param = argv[0];
-	VERIFY_TRAIT_IMPL(to_str, param, ".: could not take to_str of type '%s'", param.T->name);
-	TraitToStr to_str = param.T->to_str;
+	VERIFY_TRAIT_IMPL(to_str, param, ".: could not take to_str of type '%s'", TYPE_OF(param)->name);
+	TraitToStr to_str = TYPE_OF(param)->to_str;
 	SlashStr *param_str = AS_STR(to_str(interpreter, param));
-	return chdir(param_str->str);
+	return chdir(slash_str_cstr(interpreter, param_str));
 }
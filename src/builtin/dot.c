@@ -43,10 +43,10 @@ int builtin_dot(Interpreter *interpreter, ArenaLL *ast_nodes)
 	assert(IS_TEXT_LIT(cmd_name));
 
 	/* prepend '.' to first argument */
-	char program_name[cmd_name.text_lit.size + 2]; // + 1 for '.' and + 1 for null termination
+	char program_name[AS_TEXT_LIT(cmd_name)->size + 2]; // + 1 for '.' and + 1 for null termination
 	program_name[0] = '.';
-	strncpy(program_name + 1, cmd_name.text_lit.view, cmd_name.text_lit.size);
-	program_name[cmd_name.text_lit.size + 1] = 0;
+	strncpy(program_name + 1, AS_TEXT_LIT(cmd_name)->view, AS_TEXT_LIT(cmd_name)->size);
+	program_name[AS_TEXT_LIT(cmd_name)->size + 1] = 0;
 
 #ifdef DEBUG
 	TODO_LOG("dot builtin: Check if specified file exists and is executable");
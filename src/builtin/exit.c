@@ -17,6 +17,7 @@
 
 #include <stdlib.h>
 
+#include "builtin/builtin.h"
 #include "interpreter/interpreter.h"
 #include "interpreter/value/slash_value.h"
 #include "lib/arena_ll.h"
@@ -25,6 +26,8 @@
 
 int builtin_exit(Interpreter *interpreter, ArenaLL *ast_nodes)
 {
+	gc_stats_report_at_exit(interpreter);
+	stream_ctx_flush(&interpreter->stream_ctx);
 	if (ast_nodes == NULL)
 		exit(0);
 
@@ -33,10 +36,10 @@ int builtin_exit(Interpreter *interpreter, ArenaLL *ast_nodes)
 	ast_ll_to_argv(interpreter, ast_nodes, argv);
 	SlashValue arg = argv[0];
 	if (IS_NUM(arg))
-		exit(arg.num);
+		exit(AS_NUM(arg));
 
 	if (IS_TEXT_LIT(arg)) {
-		int exit_code = str_view_to_int(arg.text_lit);
+		int exit_code = str_view_to_int(*AS_TEXT_LIT(arg));
 		exit(exit_code);
 	}
 	exit(2);
@@ -0,0 +1,188 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtin/builtin.h"
+#include "interpreter/gc.h"
+#include "interpreter/interpreter.h"
+#include "interpreter/value/slash_str.h"
+#include "interpreter/value/slash_value.h"
+#include "interpreter/value/type_funcs.h"
+#include "lib/arena_ll.h"
+#include "options.h"
+
+#define GC_STATS_MAX_TYPES 32
+
+#define GC_STATS_PRINT(to_err, ...)                                        \
+	do {                                                                   \
+		if (to_err)                                                        \
+			SLASH_PRINT_ERR(&interpreter->stream_ctx, __VA_ARGS__);        \
+		else                                                               \
+			SLASH_PRINT(&interpreter->stream_ctx, __VA_ARGS__);            \
+	} while (0)
+
+
+static void gc_stats_print(Interpreter *interpreter, bool to_err)
+{
+	GC *gc = &interpreter->gc;
+	GCTypeCount counts[GC_STATS_MAX_TYPES];
+	size_t n = gc_count_objs(interpreter, counts, GC_STATS_MAX_TYPES);
+
+	GC_STATS_PRINT(to_err, "bytes managing:\t%zu\n", gc->bytes_managing);
+	GC_STATS_PRINT(to_err, "objects:\t%zu\n", gc->objs_len);
+	for (size_t i = 0; i < n; i++)
+		GC_STATS_PRINT(to_err, "  %s:\t%zu\n", counts[i].T->name, counts[i].count);
+	GC_STATS_PRINT(to_err, "collections:\t%zu minor, %zu major\n", gc->minor_runs,
+				   gc->major_runs);
+	GC_STATS_PRINT(to_err, "pause total:\t%.3f ms\n", gc->pause_total * 1000);
+	GC_STATS_PRINT(to_err, "pause max:\t%.3f ms\n", gc->pause_max * 1000);
+	GC_STATS_PRINT(to_err, "freed last:\t%zu minor, %zu major\n", gc->bytes_freed_minor,
+				   gc->bytes_freed_major);
+	GC_STATS_PRINT(to_err, "survival last:\t%.1f%%\n", gc->survival * 100);
+	GC_STATS_PRINT(to_err, "overhead last:\t%.1f%%\n", gc->overhead * 100);
+	GC_STATS_PRINT(to_err, "overhead target:\t%g%%\n", gc->overhead_target * 100);
+	GC_STATS_PRINT(to_err, "grow factor:\t%g (%s)\n", gc->heap_grow_factor,
+				   gc->adaptive ? "adaptive" : "fixed");
+	GC_STATS_PRINT(to_err, "min heap:\t%zu\n", gc->min_run);
+	if (gc->max_heap != 0)
+		GC_STATS_PRINT(to_err, "max heap:\t%zu\n", gc->max_heap);
+	GC_STATS_PRINT(to_err, "next major:\t%zu\n", gc->next_run);
+	GC_STATS_PRINT(to_err, "mark threads:\t%zu from %zu bytes\n", gc->mark_threads,
+				   gc->parallel_mark_min);
+}
+
+void gc_stats_report_at_exit(Interpreter *interpreter)
+{
+	if (getenv(GC_STATS_ENV) != NULL)
+		gc_stats_print(interpreter, true);
+}
+
+static bool gc_parse_num(Interpreter *interpreter, SlashValue value, double *result)
+{
+	if (IS_NUM(value)) {
+		*result = AS_NUM(value);
+		return true;
+	}
+	TraitToStr to_str = TYPE_OF(value)->to_str;
+	if (to_str == NULL)
+		return false;
+	SlashStr *str = AS_STR(to_str(interpreter, value));
+	char *cstr = slash_str_cstr(interpreter, str);
+	char *end;
+	*result = strtod(cstr, &end);
+	return end != cstr && *end == 0;
+}
+
+/*
+ * gc            print statistics
+ * gc -r         run a full collection
+ * gc -g factor  fix how much the heap may grow before the next major collection
+ * gc -a         let the grow factor adapt to the overhead target again
+ * gc -o percent set the overhead target, the wanted time collecting relative to running
+ * gc -m bytes   set the minimum heap size before a major collection
+ * gc -t threads set how many threads mark large heaps
+ * gc -p bytes   set the heap size from which major collections mark in parallel
+ */
+int builtin_gc(Interpreter *interpreter, ArenaLL *ast_nodes)
+{
+	if (ast_nodes == NULL) {
+		gc_stats_print(interpreter, false);
+		return 0;
+	}
+
+	size_t argc = ast_nodes->size;
+	SlashValue argv[argc];
+	ast_ll_to_argv(interpreter, ast_nodes, argv);
+
+	for (size_t i = 0; i < argc; i++) {
+		SlashValue param = argv[i];
+		TraitToStr to_str = TYPE_OF(param)->to_str;
+		if (to_str == NULL) {
+			SLASH_PRINT_ERR(&interpreter->stream_ctx, "gc: could not take to_str of type '%s'\n",
+							TYPE_OF(param)->name);
+			return 1;
+		}
+		char *flag = slash_str_cstr(interpreter, AS_STR(to_str(interpreter, param)));
+		if (strcmp(flag, "-r") == 0) {
+			gc_run(interpreter);
+			continue;
+		}
+		if (strcmp(flag, "-a") == 0) {
+			interpreter->gc.adaptive = true;
+			continue;
+		}
+
+		if (strcmp(flag, "-g") != 0 && strcmp(flag, "-o") != 0 && strcmp(flag, "-m") != 0 &&
+			strcmp(flag, "-t") != 0 && strcmp(flag, "-p") != 0) {
+			SLASH_PRINT_ERR(&interpreter->stream_ctx, "gc: unknown option '%s'\n", flag);
+			return 1;
+		}
+		/* flag is garbage once gc_parse_num() allocates */
+		char option = flag[1];
+		double n;
+		if (i + 1 == argc || !gc_parse_num(interpreter, argv[++i], &n)) {
+			SLASH_PRINT_ERR(&interpreter->stream_ctx, "gc: -%c expects a number\n", option);
+			return 1;
+		}
+		if (option == 'g') {
+			if (n < 1) {
+				SLASH_PRINT_ERR(&interpreter->stream_ctx, "gc: grow factor must be at least 1\n");
+				return 1;
+			}
+			interpreter->gc.heap_grow_factor = n;
+			interpreter->gc.adaptive = false;
+		} else if (option == 'o') {
+			if (n <= 0) {
+				SLASH_PRINT_ERR(&interpreter->stream_ctx, "gc: overhead target must be positive\n");
+				return 1;
+			}
+			interpreter->gc.overhead_target = n / 100;
+			continue;
+		} else if (option == 't') {
+			if (n < 1) {
+				SLASH_PRINT_ERR(&interpreter->stream_ctx, "gc: at least one thread must mark\n");
+				return 1;
+			}
+			/* not capped at the number of CPUs so parallel marking can be tested anywhere */
+			if (n > GC_MARK_THREADS_MAX)
+				n = GC_MARK_THREADS_MAX;
+			gc_set_mark_threads(&interpreter->gc, (size_t)n);
+			continue;
+		} else if (option == 'p') {
+			if (n < 0) {
+				SLASH_PRINT_ERR(&interpreter->stream_ctx, "gc: heap size can not be negative\n");
+				return 1;
+			}
+			interpreter->gc.parallel_mark_min = (size_t)n;
+			continue;
+		} else {
+			if (n < 0) {
+				SLASH_PRINT_ERR(&interpreter->stream_ctx, "gc: minimum heap can not be negative\n");
+				return 1;
+			}
+			interpreter->gc.min_run = (size_t)n;
+		}
+		/* takes effect now rather than after the next major collection */
+		if (interpreter->gc.sweep_link == NULL)
+			gc_set_next_run(&interpreter->gc);
+	}
+
+	return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "builtin/builtin.h"
+#include "builtin/path_cache.h"
+#include "interpreter/interpreter.h"
+#include "interpreter/scope.h"
+#include "interpreter/value/slash_str.h"
+#include "interpreter/value/slash_value.h"
+#include "interpreter/value/type_funcs.h"
+#include "lib/arena_ll.h"
+
+
+static void hash_print(Interpreter *interpreter)
+{
+	PathCache *cache = &interpreter->path_cache;
+	if (cache->entries.len == 0) {
+		SLASH_PRINT(&interpreter->stream_ctx, "hash: hash table empty\n");
+		return;
+	}
+
+	PathCacheEntry *entries[cache->entries.len];
+	size_t len = path_cache_entries(cache, entries);
+	SLASH_PRINT(&interpreter->stream_ctx, "hits\tcommand\n");
+	for (size_t i = 0; i < len; i++) {
+		if (entries[i]->found)
+			SLASH_PRINT(&interpreter->stream_ctx, "%4zu\t%s\n", entries[i]->hits, entries[i]->path);
+		else
+			SLASH_PRINT(&interpreter->stream_ctx, "%4zu\t%s (not found)\n", entries[i]->hits,
+						entries[i]->path);
+	}
+}
+
+/*
+ * hash         list the cached command locations
+ * hash -r      forget all cached command locations
+ * hash name..  look up each name in PATH and cache the result
+ */
+int builtin_hash(Interpreter *interpreter, ArenaLL *ast_nodes)
+{
+	if (ast_nodes == NULL) {
+		hash_print(interpreter);
+		return 0;
+	}
+
+	size_t argc = ast_nodes->size;
+	SlashValue argv[argc];
+	ast_ll_to_argv(interpreter, ast_nodes, argv);
+
+	ScopeAndValue path =
+		var_get_or_runtime_error(interpreter->scope, &(StrView){ .view = "PATH", .size = 4 });
+	if (!IS_STR(*path.value)) {
+		SLASH_PRINT_ERR(&interpreter->stream_ctx,
+						"hash: PATH variable should be type '%s' not '%s'\n", str_type_info.name,
+						TYPE_OF(*path.value)->name);
+		return 1;
+	}
+
+	int return_code = 0;
+	for (size_t i = 0; i < argc; i++) {
+		SlashValue param = argv[i];
+		TraitToStr to_str = TYPE_OF(param)->to_str;
+		if (to_str == NULL) {
+			SLASH_PRINT_ERR(&interpreter->stream_ctx, "hash: could not take to_str of type '%s'\n",
+							TYPE_OF(param)->name);
+			return 1;
+		}
+		char *name = slash_str_cstr(interpreter, AS_STR(to_str(interpreter, param)));
+		if (strcmp(name, "-r") == 0) {
+			path_cache_clear(&interpreter->path_cache);
+			continue;
+		}
+
+		char *path_cstr = slash_str_cstr(interpreter, AS_STR(*path.value));
+		PathCacheEntry *entry = path_cache_lookup(&interpreter->path_cache, path_cstr, name);
+		if (!entry->found) {
+			SLASH_PRINT_ERR(&interpreter->stream_ctx, "hash: %s: not found\n", name);
+			return_code = 1;
+		}
+	}
+
+	return return_code;
+}
@@ -0,0 +1,152 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "builtin/path_cache.h"
+#include "nicc/nicc.h"
+#include "options.h"
+
+
+static void dir_stat(PathCacheDir *dir)
+{
+	struct stat sb;
+	dir->exists = stat(dir->path, &sb) == 0;
+	dir->mtime = dir->exists ? sb.st_mtim : (struct timespec){ 0 };
+}
+
+/* Returns true if the directory was created, removed or modified since it was last stat'ed */
+static bool dir_changed(PathCacheDir *dir)
+{
+	PathCacheDir now = { .path = dir->path };
+	dir_stat(&now);
+	return now.exists != dir->exists || now.mtime.tv_sec != dir->mtime.tv_sec ||
+		   now.mtime.tv_nsec != dir->mtime.tv_nsec;
+}
+
+static void dirs_free(PathCache *cache)
+{
+	for (size_t i = 0; i < cache->dirs_len; i++)
+		free(cache->dirs[i].path);
+	free(cache->dirs);
+	free(cache->PATH);
+	cache->dirs = NULL;
+	cache->dirs_len = 0;
+	cache->PATH = NULL;
+}
+
+static void path_cache_build(PathCache *cache, char *PATH)
+{
+	path_cache_clear(cache);
+	cache->PATH = strdup(PATH);
+
+	size_t dirs_cap = 8;
+	cache->dirs = malloc(sizeof(PathCacheDir) * dirs_cap);
+	char *path_cpy = strdup(PATH);
+	for (char *dir = strtok(path_cpy, ":"); dir != NULL; dir = strtok(NULL, ":")) {
+		if (cache->dirs_len >= dirs_cap) {
+			dirs_cap *= 2;
+			cache->dirs = realloc(cache->dirs, sizeof(PathCacheDir) * dirs_cap);
+		}
+		PathCacheDir *new_dir = &cache->dirs[cache->dirs_len++];
+		new_dir->path = strdup(dir);
+		dir_stat(new_dir);
+	}
+	free(path_cpy);
+}
+
+/*
+ * A positive entry can only be invalidated by the directories up to and including the one it
+ * was found in, while a negative entry can be invalidated by any directory.
+ */
+static bool entry_is_stale(PathCache *cache, PathCacheEntry *entry)
+{
+	size_t searched = entry->found ? entry->dir + 1 : cache->dirs_len;
+	for (size_t i = 0; i < searched; i++) {
+		if (dir_changed(&cache->dirs[i]))
+			return true;
+	}
+	return false;
+}
+
+static PathCacheEntry search_dirs(PathCache *cache, char *command)
+{
+	PathCacheEntry entry = { .found = false, .hits = 0 };
+	for (size_t i = 0; i < cache->dirs_len; i++) {
+		struct stat sb;
+		snprintf(entry.path, PROGRAM_PATH_MAX_LEN, "%s/%s", cache->dirs[i].path, command);
+		/* check if executable bit is on */
+		if (stat(entry.path, &sb) == 0 && sb.st_mode & S_IXUSR && !S_ISDIR(sb.st_mode)) {
+			entry.found = true;
+			entry.dir = i;
+			return entry;
+		}
+	}
+	snprintf(entry.path, PROGRAM_PATH_MAX_LEN, "%s", command);
+	return entry;
+}
+
+void path_cache_init(PathCache *cache)
+{
+	hashmap_init(&cache->entries);
+	cache->PATH = NULL;
+	cache->dirs = NULL;
+	cache->dirs_len = 0;
+}
+
+void path_cache_free(PathCache *cache)
+{
+	hashmap_free(&cache->entries);
+	dirs_free(cache);
+}
+
+void path_cache_clear(PathCache *cache)
+{
+	hashmap_free(&cache->entries);
+	hashmap_init(&cache->entries);
+	dirs_free(cache);
+}
+
+PathCacheEntry *path_cache_lookup(PathCache *cache, char *PATH, char *command)
+{
+	if (cache->PATH == NULL || strcmp(cache->PATH, PATH) != 0)
+		path_cache_build(cache, PATH);
+
+	uint32_t key_size = strlen(command) + 1;
+	PathCacheEntry *entry = hashmap_get(&cache->entries, command, key_size);
+	if (entry != NULL && entry_is_stale(cache, entry)) {
+		/* the directories we know of may have new content, so start over */
+		path_cache_build(cache, PATH);
+		entry = NULL;
+	}
+
+	if (entry == NULL) {
+		PathCacheEntry new_entry = search_dirs(cache, command);
+		hashmap_put(&cache->entries, command, key_size, &new_entry, sizeof(PathCacheEntry), true);
+		entry = hashmap_get(&cache->entries, command, key_size);
+	}
+	entry->hits++;
+	return entry;
+}
+
+size_t path_cache_entries(PathCache *cache, PathCacheEntry **entries)
+{
+	hashmap_get_values(&cache->entries, (void **)entries);
+	return cache->entries.len;
+}
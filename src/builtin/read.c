@@ -47,18 +47,18 @@ int builtin_read(Interpreter *interpreter, ArenaLL *ast_nodes)
 	SlashValue arg = argv[0];
 	if (!IS_TEXT_LIT(arg)) {
 		SLASH_PRINT_ERR(&interpreter->stream_ctx, "read: expected argument to be text, not '%s'\n",
-						arg.T->name);
+						TYPE_OF(arg)->name);
 		return 1;
 	}
 
+	stream_ctx_flush(&interpreter->stream_ctx);
 	Prompt prompt;
 	prompt_init(&prompt, ">>>");
 	prompt_run(&prompt, false);
 	StrView input = (StrView){ .view = prompt.buf, .size = prompt.buf_len - 2 };
 
-	SlashObj *str = gc_new_T(interpreter, &str_type_info);
-	slash_str_init_from_view(interpreter, (SlashStr *)str, &input);
-	var_define(interpreter->scope, &arg.text_lit, &AS_VALUE(str));
+	SlashStr *str = slash_str_new_from_view(interpreter, &input);
+	var_define(interpreter->scope, AS_TEXT_LIT(arg), &AS_VALUE(str));
 
 	prompt_free(&prompt);
 	return 0;
@@ -50,7 +50,7 @@ int builtin_time(Interpreter *interpreter, ArenaLL *ast_nodes)
 	struct rusage start_usage;
 	getrusage(RUSAGE_SELF, &start_usage);
 
-	CmdStmt cmd = { .type = STMT_CMD, .cmd_name = cmd_name.text_lit, .arg_exprs = ast_nodes };
+	CmdStmt cmd = { .type = STMT_CMD, .cmd_name = *AS_TEXT_LIT(cmd_name), .arg_exprs = ast_nodes };
 	exec_cmd(interpreter, &cmd);
 
 	gettimeofday(&t1, 0);
@@ -14,13 +14,11 @@
  *  You should have received a copy of the GNU General Public License
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
-#include <dirent.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
 
 #include "builtin/builtin.h"
+#include "builtin/path_cache.h"
 #include "interpreter/interpreter.h"
 #include "interpreter/scope.h"
 #include "interpreter/value/slash_str.h"
@@ -35,52 +33,11 @@ Builtin builtins[] = {
 	{ .name = "which", .func = builtin_which }, { .name = "cd", .func = builtin_cd },
 	{ .name = "vars", .func = builtin_vars },	{ .name = "exit", .func = builtin_exit },
 	{ .name = "read", .func = builtin_read },	{ .name = ".", .func = builtin_dot },
-	{ .name = "time", .func = builtin_time }
+	{ .name = "time", .func = builtin_time },	{ .name = "hash", .func = builtin_hash },
+	{ .name = "gc", .func = builtin_gc }
 };
 
 
-static void which_internal(WhichResult *mutable_result, char *PATH, char *command)
-{
-	/* PATH environment variable is often prefixed with 'PATH=' */
-	size_t PATH_len = strlen(PATH) + 1;
-	// TODO: use ArenaTmp and StrBuilder
-	char *path_cpy = malloc(PATH_len);
-	memcpy(path_cpy, PATH, PATH_len);
-
-	char *single_path = strtok(path_cpy, ":");
-	while (single_path != NULL) {
-		DIR *path_dir = opendir(single_path);
-
-		struct dirent *candidate_program;
-		while (path_dir != NULL && (candidate_program = readdir(path_dir)) != NULL) {
-			struct stat sb;
-			/* check for name equality */
-			if (strcmp(command, candidate_program->d_name) == 0)
-				continue;
-
-			snprintf(mutable_result->path, PROGRAM_PATH_MAX_LEN, "%s/%s", single_path, command);
-			/* check if executable bit is on */
-			if (stat(mutable_result->path, &sb) == 0 && sb.st_mode & S_IXUSR &&
-				!S_ISDIR(sb.st_mode)) {
-				mutable_result->type = WHICH_EXTERN;
-				free(path_cpy);
-				closedir(path_dir);
-				return;
-			}
-			/* can not be in this path_dir as file with matching name is not an executable */
-			break;
-		}
-
-		if (path_dir != NULL)
-			closedir(path_dir);
-		single_path = strtok(NULL, ":");
-	}
-
-	free(path_cpy);
-	mutable_result->type = WHICH_NOT_FOUND;
-}
-
-
 int builtin_which(Interpreter *interpreter, ArenaLL *ast_nodes)
 {
 	if (ast_nodes == NULL) {
@@ -92,10 +49,10 @@ int builtin_which(Interpreter *interpreter, ArenaLL *ast_nodes)
 	ast_ll_to_argv(interpreter, ast_nodes, argv);
 
 	SlashValue param = argv[0];
-	TraitToStr to_str = param.T->to_str;
+	TraitToStr to_str = TYPE_OF(param)->to_str;
 	if (to_str == NULL) {
 		SLASH_PRINT_ERR(&interpreter->stream_ctx, "which: could not take to_str of type '%s'",
-						param.T->name);
+						TYPE_OF(param)->name);
 		return 1;
 	}
 	SlashStr *param_str = AS_STR(to_str(interpreter, param));
@@ -104,23 +61,25 @@ int builtin_which(Interpreter *interpreter, ArenaLL *ast_nodes)
 	if (!IS_STR(*path.value)) {
 		SLASH_PRINT_ERR(&interpreter->stream_ctx,
 						"which: PATH variable should be type '%s' not '%s'", str_type_info.name,
-						path.value->T->name);
+						TYPE_OF(*path.value)->name);
 		return 1;
 	}
 
-	WhichResult which_result = which((StrView){ .view = param_str->str, .size = param_str->len },
-									 AS_STR(*path.value)->str);
+	char *name = slash_str_cstr(interpreter, param_str);
+	WhichResult which_result =
+		which(&interpreter->path_cache, (StrView){ .view = name, .size = param_str->len },
+			  slash_str_cstr(interpreter, AS_STR(*path.value)));
 
 	int return_code = 0;
 	switch (which_result.type) {
 	case WHICH_BUILTIN:
-		SLASH_PRINT(&interpreter->stream_ctx, "%s: slash builtin\n", param_str->str);
+		SLASH_PRINT(&interpreter->stream_ctx, "%s: slash builtin\n", name);
 		break;
 	case WHICH_EXTERN:
 		SLASH_PRINT(&interpreter->stream_ctx, "%s\n", which_result.path);
 		break;
 	case WHICH_NOT_FOUND:
-		SLASH_PRINT(&interpreter->stream_ctx, "%s not found\n", param_str->str);
+		SLASH_PRINT(&interpreter->stream_ctx, "%s not found\n", name);
 		return_code = 1;
 		break;
 	}
@@ -128,7 +87,7 @@ int builtin_which(Interpreter *interpreter, ArenaLL *ast_nodes)
 	return return_code;
 }
 
-WhichResult which(StrView cmd, char *PATH)
+WhichResult which(PathCache *path_cache, StrView cmd, char *PATH)
 {
 	char command[cmd.size + 1];
 	str_view_to_cstr(cmd, command);
@@ -153,6 +112,12 @@ WhichResult which(StrView cmd, char *PATH)
 	}
 
 	/* execution enters here means cmd is not a builtin */
-	which_internal(&result, PATH, command);
+	PathCacheEntry *entry = path_cache_lookup(path_cache, PATH, command);
+	if (!entry->found) {
+		result.type = WHICH_NOT_FOUND;
+		return result;
+	}
+	result.type = WHICH_EXTERN;
+	memcpy(result.path, entry->path, PROGRAM_PATH_MAX_LEN);
 	return result;
 }
@@ -106,7 +106,14 @@ Expr *expr_copy(Arena *arena, Expr *to_copy)
 		break;
 	}
 	case EXPR_LITERAL: {
-		((LiteralExpr *)copy)->value = ((LiteralExpr *)to_copy)->value;
+		SlashValue value = ((LiteralExpr *)to_copy)->value;
+		/* text literals reference a StrView owned by the AST */
+		if (IS_TEXT_LIT(value)) {
+			StrView *view_cpy = m_arena_alloc_struct(arena, StrView);
+			*view_cpy = str_view_arena_copy(arena, *AS_TEXT_LIT(value));
+			value = TEXT_LIT_VAL(view_cpy);
+		}
+		((LiteralExpr *)copy)->value = value;
 		break;
 	}
 	case EXPR_ACCESS: {
@@ -377,13 +384,13 @@ static void ast_print_literal(LiteralExpr *expr, int depth)
 	(void)depth;
 	SlashValue literal = expr->value;
 	if (IS_BOOL(literal))
-		printf("%s", literal.boolean == true ? "true" : "false");
+		printf("%s", AS_BOOL(literal) == true ? "true" : "false");
 	else if (IS_NUM(literal))
-		printf("%f", literal.num);
+		printf("%f", AS_NUM(literal));
 	else if (IS_RANGE(literal))
-		printf("%d -> %d", literal.range.start, literal.range.end);
+		printf("%d -> %d", AS_RANGE(literal)->start, AS_RANGE(literal)->end);
 	else if (IS_TEXT_LIT(literal))
-		str_view_print(literal.text_lit);
+		str_view_print(*AS_TEXT_LIT(literal));
 }
 
 static void ast_print_access(AccessExpr *expr, int depth)
@@ -0,0 +1,1105 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "interpreter/ast.h"
+#include "interpreter/compiler.h"
+#include "interpreter/lexer.h"
+#include "interpreter/scope.h"
+#include "interpreter/str_pool.h"
+#include "interpreter/value/slash_value.h"
+#include "lib/arena_ll.h"
+#include "lib/str_view.h"
+#include "nicc/nicc.h"
+#include "options.h"
+#include "sac/sac.h"
+
+
+#define X(op) #op,
+char *op_code_str_map[OP_ENUM_COUNT] = { OPCODES };
+#undef X
+
+typedef struct loop_ctx_t LoopCtx;
+struct loop_ctx_t {
+	LoopCtx *enclosing;
+	size_t scope_depth; // scope depth inside the loop scope
+	ArrayList breaks; // offsets of jump operands that should be patched to the loop exit
+	ArrayList continues; // offsets of jump operands that should be patched to the loop continue
+};
+
+/* A variable declared by the chunk that has been resolved to a slot */
+typedef struct {
+	StrView name;
+	size_t scope_depth;
+	uint32_t slot;
+} Local;
+
+typedef struct {
+	ArrayList names; // StrView. Slot -> name
+	size_t operand_pos; // position of the PUSH_SCOPE operands. Not used by the frame scope
+} CompilerScope;
+
+typedef struct {
+	Chunk *chunk;
+	bool in_function;
+	Scope *globals; // global scope whose slots are reserved at the top-level. NULL in functions
+	StrPool *str_pool; // str literals are interned here, and referenced by the chunk
+	ArrayList locals; // Local. Innermost declaration last
+	ArrayList scopes; // CompilerScope. The frame scope first
+	size_t scope_depth; // amount of scopes pushed by the chunk at the current point
+	size_t stack_depth; // amount of values on the value stack at the current point
+	LoopCtx *loop; // innermost loop, NULL if not inside a loop
+	int prev_line; // line of the previous OP_LINE, -1 if unknown
+} Compiler;
+
+static void compile_expr(Compiler *compiler, Expr *expr);
+static void compile_stmt(Compiler *compiler, Stmt *stmt);
+
+
+/*
+ * chunk functions
+ */
+void chunk_init(Chunk *chunk)
+{
+	*chunk = (Chunk){ 0 };
+}
+
+void chunk_free(Chunk *chunk)
+{
+	free(chunk->code);
+	free(chunk->constants);
+	free(chunk->nodes);
+	free(chunk->slot_names);
+	chunk_init(chunk);
+}
+
+Chunk *chunk_move_to_arena(Arena *arena, Chunk *chunk)
+{
+	Chunk *moved = m_arena_alloc_struct(arena, Chunk);
+	*moved = *chunk;
+	moved->constants = m_arena_alloc(arena, sizeof(SlashValue) * chunk->constants_len);
+	if (chunk->constants_len != 0)
+		memcpy(moved->constants, chunk->constants, sizeof(SlashValue) * chunk->constants_len);
+	moved->nodes = m_arena_alloc(arena, sizeof(void *) * chunk->nodes_len);
+	if (chunk->nodes_len != 0)
+		memcpy(moved->nodes, chunk->nodes, sizeof(void *) * chunk->nodes_len);
+	moved->code = m_arena_alloc(arena, sizeof(uint32_t) * chunk->len);
+	if (chunk->len != 0)
+		memcpy(moved->code, chunk->code, sizeof(uint32_t) * chunk->len);
+	moved->slot_names = m_arena_alloc(arena, sizeof(StrView) * chunk->slot_names_len);
+	if (chunk->slot_names_len != 0)
+		memcpy(moved->slot_names, chunk->slot_names, sizeof(StrView) * chunk->slot_names_len);
+	moved->cap = moved->len;
+	moved->constants_cap = moved->constants_len;
+	moved->nodes_cap = moved->nodes_len;
+	moved->slot_names_cap = moved->slot_names_len;
+	chunk_free(chunk);
+	return moved;
+}
+
+void chunk_disassemble(Chunk *chunk)
+{
+	for (size_t i = 0; i < chunk->len;) {
+		OpCode op = chunk->code[i];
+		printf("%04zu %-16s", i, op_code_str_map[op]);
+		i++;
+		switch (op) {
+		case OP_CONSTANT:
+		case OP_STR:
+		case OP_GET_VAR:
+		case OP_SET_VAR:
+		case OP_CAST:
+		case OP_CAST_TMP: {
+			SlashValue constant = chunk->constants[chunk->code[i++]];
+			if (IS_TEXT_LIT(constant))
+				printf(" '%.*s'", (int)AS_TEXT_LIT(constant)->size, AS_TEXT_LIT(constant)->view);
+			else if (IS_NUM(constant))
+				printf(" %g", AS_NUM(constant));
+			else
+				printf(" <%s>", TYPE_OF(constant)->name);
+			break;
+		}
+		case OP_JUMP:
+		case OP_JUMP_IF_FALSE:
+		case OP_JUMP_IF_TRUE:
+			printf(" -> %04zu", i + 1 + chunk->code[i]);
+			i++;
+			break;
+		case OP_LOOP:
+			printf(" -> %04zu", i + 1 - chunk->code[i]);
+			i++;
+			break;
+		case OP_ITER_NEXT:
+			printf(" %u -> %04zu", chunk->code[i], i + 2 + chunk->code[i + 1]);
+			i += 2;
+			break;
+		case OP_GET_LOCAL:
+		case OP_SET_LOCAL: {
+			StrView name = *AS_TEXT_LIT(chunk->constants[chunk->code[i + 2]]);
+			printf(" %u %u '%.*s'", chunk->code[i], chunk->code[i + 1], (int)name.size, name.view);
+			i += 3;
+			break;
+		}
+		case OP_PUSH_SCOPE:
+		case OP_SUBSCRIPT_ASSIGN:
+			printf(" %u %u", chunk->code[i], chunk->code[i + 1]);
+			i += 2;
+			break;
+		case OP_POPN:
+		case OP_LINE:
+		case OP_DEFINE_LOCAL:
+		case OP_BINARY:
+		case OP_LIST:
+		case OP_TUPLE:
+		case OP_MAP:
+		case OP_UNPACK:
+		case OP_FUNCTION:
+		case OP_CALL:
+		case OP_LINE_STREAM:
+		case OP_EVAL_EXPR:
+		case OP_EXEC_STMT:
+			printf(" %u", chunk->code[i++]);
+			break;
+		default:
+			break;
+		}
+		putchar('\n');
+	}
+}
+
+
+/*
+ * emit helpers
+ */
+static void emit(Compiler *compiler, uint32_t word)
+{
+	Chunk *chunk = compiler->chunk;
+	if (chunk->len >= chunk->cap) {
+		chunk->cap = chunk->cap == 0 ? 64 : chunk->cap * 2;
+		chunk->code = realloc(chunk->code, sizeof(uint32_t) * chunk->cap);
+	}
+	chunk->code[chunk->len++] = word;
+}
+
+/* Emits an opcode and records how it changes the amount of values on the value stack */
+static void emit_op(Compiler *compiler, OpCode op, int stack_effect)
+{
+	emit(compiler, op);
+	compiler->stack_depth += stack_effect;
+	if (compiler->stack_depth > compiler->chunk->max_stack)
+		compiler->chunk->max_stack = compiler->stack_depth;
+}
+
+static void emit_op_operand(Compiler *compiler, OpCode op, int stack_effect, uint32_t operand)
+{
+	emit_op(compiler, op, stack_effect);
+	emit(compiler, operand);
+}
+
+static uint32_t add_constant(Compiler *compiler, SlashValue value)
+{
+	Chunk *chunk = compiler->chunk;
+	if (chunk->constants_len >= chunk->constants_cap) {
+		chunk->constants_cap = chunk->constants_cap == 0 ? 16 : chunk->constants_cap * 2;
+		chunk->constants = realloc(chunk->constants, sizeof(SlashValue) * chunk->constants_cap);
+	}
+	chunk->constants[chunk->constants_len] = value;
+	return chunk->constants_len++;
+}
+
+/* The name must outlive the chunk, which is the case for names that point into the AST */
+static uint32_t add_name(Compiler *compiler, StrView *name)
+{
+	return add_constant(compiler, TEXT_LIT_VAL(name));
+}
+
+/* The entry of a str literal is referenced through the text_lit of its view, see OP_STR */
+static uint32_t add_str_literal(Compiler *compiler, StrView *view)
+{
+	StrPoolEntry *entry = str_pool_intern(compiler->str_pool, view);
+	return add_name(compiler, &entry->view);
+}
+
+static uint32_t add_node(Compiler *compiler, void *node)
+{
+	Chunk *chunk = compiler->chunk;
+	if (chunk->nodes_len >= chunk->nodes_cap) {
+		chunk->nodes_cap = chunk->nodes_cap == 0 ? 8 : chunk->nodes_cap * 2;
+		chunk->nodes = realloc(chunk->nodes, sizeof(void *) * chunk->nodes_cap);
+	}
+	chunk->nodes[chunk->nodes_len] = node;
+	return chunk->nodes_len++;
+}
+
+/* Emits a jump with a placeholder offset. Returns the position of the offset operand */
+static size_t emit_jump(Compiler *compiler, OpCode op)
+{
+	emit_op_operand(compiler, op, op == OP_JUMP ? 0 : -1, 0);
+	return compiler->chunk->len - 1;
+}
+
+/* Patches the jump operand at the given position to jump to the current end of the chunk */
+static void patch_jump(Compiler *compiler, size_t operand_pos)
+{
+	compiler->chunk->code[operand_pos] = compiler->chunk->len - (operand_pos + 1);
+	/* Execution may come from elsewhere, so the line can no longer be assumed */
+	compiler->prev_line = -1;
+}
+
+static void emit_loop(Compiler *compiler, size_t loop_start)
+{
+	emit_op(compiler, OP_LOOP, 0);
+	emit(compiler, compiler->chunk->len + 1 - loop_start);
+}
+
+static void emit_line(Compiler *compiler, Expr *expr)
+{
+	int line = expr->source_line + 1; // NOTE: 0 indexed
+	if (line == compiler->prev_line)
+		return;
+	emit_op_operand(compiler, OP_LINE, 0, (uint32_t)line);
+	compiler->prev_line = line;
+}
+
+/* Falls back to the tree-walker for the given expression */
+static void emit_eval_expr(Compiler *compiler, Expr *expr)
+{
+	emit_op_operand(compiler, OP_EVAL_EXPR, 1, add_node(compiler, expr));
+	compiler->prev_line = -1;
+}
+
+/* Falls back to the tree-walker for the given statement */
+static void emit_exec_stmt(Compiler *compiler, Stmt *stmt)
+{
+	emit_op_operand(compiler, OP_EXEC_STMT, 0, add_node(compiler, stmt));
+	compiler->prev_line = -1;
+}
+
+
+/*
+ * resolver
+ */
+static CompilerScope *current_scope(Compiler *compiler)
+{
+	return arraylist_get(&compiler->scopes, compiler->scopes.size - 1);
+}
+
+static void begin_scope(Compiler *compiler, size_t operand_pos)
+{
+	CompilerScope scope = { .operand_pos = operand_pos };
+	arraylist_init(&scope.names, sizeof(StrView));
+	arraylist_append(&compiler->scopes, &scope);
+}
+
+/* Appends the names of the slots of the innermost scope to the chunk and returns their offset */
+static uint32_t end_scope(Compiler *compiler)
+{
+	Chunk *chunk = compiler->chunk;
+	CompilerScope *scope = current_scope(compiler);
+	size_t n = scope->names.size;
+	if (chunk->slot_names_len + n > chunk->slot_names_cap) {
+		chunk->slot_names_cap = chunk->slot_names_cap == 0 ? 16 : chunk->slot_names_cap * 2;
+		if (chunk->slot_names_len + n > chunk->slot_names_cap)
+			chunk->slot_names_cap = chunk->slot_names_len + n;
+		chunk->slot_names = realloc(chunk->slot_names, sizeof(StrView) * chunk->slot_names_cap);
+	}
+	uint32_t offset = chunk->slot_names_len;
+	for (size_t i = 0; i < n; i++)
+		chunk->slot_names[chunk->slot_names_len++] = *(StrView *)arraylist_get(&scope->names, i);
+
+	arraylist_free(&scope->names);
+	arraylist_pop(&compiler->scopes);
+	/* locals of the scope go out of scope */
+	while (compiler->locals.size > 0) {
+		Local *local = arraylist_get(&compiler->locals, compiler->locals.size - 1);
+		if (local->scope_depth < compiler->scope_depth)
+			break;
+		arraylist_pop(&compiler->locals);
+	}
+	return offset;
+}
+
+static Local *find_local(Compiler *compiler, StrView name)
+{
+	for (size_t i = compiler->locals.size; i > 0; i--) {
+		Local *local = arraylist_get(&compiler->locals, i - 1);
+		if (str_view_eq(local->name, name))
+			return local;
+	}
+	return NULL;
+}
+
+static void add_local(Compiler *compiler, StrView name, uint32_t slot)
+{
+	Local local = { .name = name, .scope_depth = compiler->scope_depth, .slot = slot };
+	arraylist_append(&compiler->locals, &local);
+}
+
+/*
+ * Declares a variable in the current scope and returns its slot.
+ * Declaring the same name twice in a scope gives the same slot so that the redefinition is
+ * reported at runtime.
+ */
+static uint32_t declare_local(Compiler *compiler, StrView name)
+{
+	Local *local = find_local(compiler, name);
+	if (local != NULL && local->scope_depth == compiler->scope_depth)
+		return local->slot;
+
+	uint32_t slot;
+	if (compiler->scope_depth == 0 && compiler->globals != NULL) {
+		slot = scope_reserve_slot(compiler->globals, &name);
+	} else {
+		CompilerScope *scope = current_scope(compiler);
+		slot = scope->names.size;
+		arraylist_append(&scope->names, &name);
+	}
+	add_local(compiler, name, slot);
+	return slot;
+}
+
+/* Returns false if the variable can only be looked up by name at runtime */
+static bool resolve(Compiler *compiler, StrView name, uint32_t *depth, uint32_t *slot)
+{
+	Local *local = find_local(compiler, name);
+	if (local != NULL) {
+		*depth = compiler->scope_depth - local->scope_depth;
+		*slot = local->slot;
+		return true;
+	}
+
+	/*
+	 * Functions are called in the scope of the caller, so anything not declared by the function
+	 * itself can only be known at runtime. At the top-level the global scope is always the
+	 * outermost scope.
+	 */
+	if (compiler->globals == NULL)
+		return false;
+	ssize_t global_slot = scope_find_slot(compiler->globals, &name);
+	if (global_slot == -1)
+		return false;
+	*depth = compiler->scope_depth;
+	*slot = global_slot;
+	return true;
+}
+
+static void emit_get_var(Compiler *compiler, StrView *name)
+{
+	uint32_t depth, slot;
+	if (!resolve(compiler, *name, &depth, &slot)) {
+		emit_op_operand(compiler, OP_GET_VAR, 1, add_name(compiler, name));
+		return;
+	}
+	emit_op_operand(compiler, OP_GET_LOCAL, 1, depth);
+	emit(compiler, slot);
+	emit(compiler, add_name(compiler, name));
+}
+
+static void emit_set_var(Compiler *compiler, StrView *name)
+{
+	uint32_t depth, slot;
+	if (!resolve(compiler, *name, &depth, &slot)) {
+		emit_op_operand(compiler, OP_SET_VAR, -1, add_name(compiler, name));
+		return;
+	}
+	emit_op_operand(compiler, OP_SET_LOCAL, -1, depth);
+	emit(compiler, slot);
+	emit(compiler, add_name(compiler, name));
+}
+
+static OpCode binary_op_to_opcode(TokenType op)
+{
+	switch (op) {
+	case t_plus:
+	case t_plus_equal:
+		return OP_ADD;
+	case t_minus:
+	case t_minus_equal:
+		return OP_SUB;
+	case t_star:
+	case t_star_equal:
+		return OP_MUL;
+	case t_equal_equal:
+		return OP_EQ;
+	case t_bang_equal:
+		return OP_NE;
+	case t_greater:
+		return OP_GT;
+	case t_greater_equal:
+		return OP_GE;
+	case t_less:
+		return OP_LT;
+	case t_less_equal:
+		return OP_LE;
+	default:
+		return OP_BINARY;
+	}
+}
+
+/* Emits the operator for two operands on the stack */
+static void emit_binary_op(Compiler *compiler, TokenType op)
+{
+	OpCode op_code = binary_op_to_opcode(op);
+	if (op_code == OP_BINARY)
+		emit_op_operand(compiler, OP_BINARY, -1, op);
+	else
+		emit_op(compiler, op_code, -1);
+}
+
+
+/*
+ * expressions
+ */
+/*
+ * Escape analysis.
+ * Comparisons only read their operands. A str literal, concatenation or cast to str that is an
+ * operand of a comparison, or of another such expression, can therefore not outlive the comparison.
+ * These are put on the tmp arena, which is released as soon as the comparison is done. Other
+ * expressions, like function calls, may keep what they create and are allocated by the GC as usual.
+ * A str literal does not allocate at all, as it evaluates to the str shared through the str pool.
+ */
+static bool is_cast_to_str(CastExpr *expr)
+{
+	return str_view_eq(expr->type_name, (StrView){ .view = "str", .size = 3 });
+}
+
+static bool is_tmp_str_expr(Expr *expr)
+{
+	switch (expr->type) {
+	case EXPR_STR:
+		return true;
+	case EXPR_GROUPING:
+		return is_tmp_str_expr(((GroupingExpr *)expr)->expr);
+	case EXPR_BINARY:
+		return ((BinaryExpr *)expr)->operator_ == t_plus;
+	case EXPR_CAST:
+		return is_cast_to_str((CastExpr *)expr);
+	default:
+		return false;
+	}
+}
+
+/* Compiles the operand of a comparison, putting any str it creates on the tmp arena */
+static void compile_tmp_operand(Compiler *compiler, Expr *expr)
+{
+	if (!is_tmp_str_expr(expr)) {
+		compile_expr(compiler, expr);
+		return;
+	}
+
+	emit_line(compiler, expr);
+	switch (expr->type) {
+	case EXPR_STR:
+		emit_op_operand(compiler, OP_STR, 1, add_str_literal(compiler, &((StrExpr *)expr)->view));
+		break;
+	case EXPR_GROUPING:
+		compile_tmp_operand(compiler, ((GroupingExpr *)expr)->expr);
+		break;
+	case EXPR_BINARY:
+		compile_tmp_operand(compiler, ((BinaryExpr *)expr)->left);
+		compile_tmp_operand(compiler, ((BinaryExpr *)expr)->right);
+		emit_op(compiler, OP_ADD_TMP, -1);
+		break;
+	case EXPR_CAST:
+		compile_tmp_operand(compiler, ((CastExpr *)expr)->expr);
+		emit_op_operand(compiler, OP_CAST_TMP, 0,
+						add_name(compiler, &((CastExpr *)expr)->type_name));
+		break;
+	default:
+		assert(false);
+	}
+}
+
+static bool is_comparison(TokenType op)
+{
+	switch (op) {
+	case t_equal_equal:
+	case t_bang_equal:
+	case t_greater:
+	case t_greater_equal:
+	case t_less:
+	case t_less_equal:
+	case t_in:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void compile_comparison(Compiler *compiler, BinaryExpr *expr)
+{
+	emit_op(compiler, OP_TMP_BEGIN, 1);
+	compile_tmp_operand(compiler, expr->left);
+	compile_tmp_operand(compiler, expr->right);
+	if (expr->operator_ == t_in)
+		emit_op(compiler, OP_IN, -1);
+	else
+		emit_binary_op(compiler, expr->operator_);
+	emit_op(compiler, OP_TMP_END, -1);
+}
+
+static void compile_binary(Compiler *compiler, BinaryExpr *expr)
+{
+	if (expr->operator_ == t_and) {
+		compile_expr(compiler, expr->left);
+		size_t false_jump = emit_jump(compiler, OP_JUMP_IF_FALSE);
+		compile_expr(compiler, expr->right);
+		emit_op(compiler, OP_TRUTHY, 0);
+		size_t end_jump = emit_jump(compiler, OP_JUMP);
+		/* The false branch and the true branch both leave exactly one value */
+		compiler->stack_depth--;
+		patch_jump(compiler, false_jump);
+		emit_op(compiler, OP_FALSE, 1);
+		patch_jump(compiler, end_jump);
+		return;
+	}
+
+	if (is_comparison(expr->operator_) &&
+		(is_tmp_str_expr(expr->left) || is_tmp_str_expr(expr->right))) {
+		compile_comparison(compiler, expr);
+		return;
+	}
+
+	compile_expr(compiler, expr->left);
+	compile_expr(compiler, expr->right);
+	switch (expr->operator_) {
+	case t_or:
+		emit_op(compiler, OP_OR, -1);
+		break;
+	case t_dot_dot:
+		emit_op(compiler, OP_RANGE, -1);
+		break;
+	case t_in:
+		emit_op(compiler, OP_IN, -1);
+		break;
+	default:
+		emit_binary_op(compiler, expr->operator_);
+	}
+}
+
+static void compile_sequence(Compiler *compiler, SequenceExpr *seq)
+{
+	LLItem *item;
+	ARENA_LL_FOR_EACH(&seq->seq, item)
+	{
+		compile_expr(compiler, item->value);
+	}
+}
+
+static void compile_list(Compiler *compiler, ListExpr *expr)
+{
+	if (expr->exprs == NULL) {
+		emit_op_operand(compiler, OP_LIST, 1, 0);
+		return;
+	}
+	size_t n = expr->exprs->seq.size;
+	compile_sequence(compiler, expr->exprs);
+	emit_op_operand(compiler, OP_LIST, 1 - (int)n, n);
+}
+
+static void compile_map(Compiler *compiler, MapExpr *expr)
+{
+	if (expr->key_value_pairs == NULL) {
+		emit_op_operand(compiler, OP_MAP, 1, 0);
+		return;
+	}
+	LLItem *item;
+	ARENA_LL_FOR_EACH(expr->key_value_pairs, item)
+	{
+		KeyValuePair *pair = item->value;
+		compile_expr(compiler, pair->key);
+		compile_expr(compiler, pair->value);
+	}
+	size_t n = expr->key_value_pairs->size;
+	emit_op_operand(compiler, OP_MAP, 1 - 2 * (int)n, n);
+}
+
+static void compile_cast(Compiler *compiler, CastExpr *expr)
+{
+	compile_expr(compiler, expr->expr);
+	/*
+	 * When LHS is a subshell and RHS is boolean then the final exit code of the subshell
+	 * expression determines the boolean value.
+	 */
+	if (expr->expr->type == EXPR_SUBSHELL &&
+		str_view_eq(expr->type_name, (StrView){ .view = "bool", .size = 4 })) {
+		emit_op(compiler, OP_POP, -1);
+		emit_op(compiler, OP_EXIT_CODE, 1);
+		return;
+	}
+	emit_op_operand(compiler, OP_CAST, 0, add_name(compiler, &expr->type_name));
+}
+
+static void compile_call(Compiler *compiler, CallExpr *expr)
+{
+	compile_expr(compiler, expr->callee);
+	size_t argc = 0;
+	if (expr->args != NULL) {
+		argc = expr->args->seq.size;
+		compile_sequence(compiler, expr->args);
+	}
+	emit_op_operand(compiler, OP_CALL, -(int)argc, argc);
+	/* The callee reports errors using its own lines */
+	compiler->prev_line = -1;
+}
+
+static void compile_expr(Compiler *compiler, Expr *expr)
+{
+	emit_line(compiler, expr);
+	switch (expr->type) {
+	case EXPR_UNARY: {
+		UnaryExpr *unary = (UnaryExpr *)expr;
+		compile_expr(compiler, unary->right);
+		if (unary->operator_ == t_not)
+			emit_op(compiler, OP_NOT, 0);
+		else if (unary->operator_ == t_minus)
+			emit_op(compiler, OP_NEGATE, 0);
+		else {
+			/* let the tree-walker report the error */
+			emit_op(compiler, OP_POP, -1);
+			emit_eval_expr(compiler, expr);
+		}
+		break;
+	}
+	case EXPR_BINARY:
+		compile_binary(compiler, (BinaryExpr *)expr);
+		break;
+	case EXPR_LITERAL:
+		emit_op_operand(compiler, OP_CONSTANT, 1,
+						add_constant(compiler, ((LiteralExpr *)expr)->value));
+		break;
+	case EXPR_ACCESS:
+		emit_get_var(compiler, &((AccessExpr *)expr)->var_name);
+		break;
+	case EXPR_SUBSCRIPT:
+		compile_expr(compiler, ((SubscriptExpr *)expr)->expr);
+		compile_expr(compiler, ((SubscriptExpr *)expr)->access_value);
+		emit_op(compiler, OP_SUBSCRIPT, -1);
+		break;
+	case EXPR_STR:
+		emit_op_operand(compiler, OP_STR, 1, add_str_literal(compiler, &((StrExpr *)expr)->view));
+		break;
+	case EXPR_LIST:
+		compile_list(compiler, (ListExpr *)expr);
+		break;
+	case EXPR_FUNCTION:
+		emit_op_operand(compiler, OP_FUNCTION, 1, add_node(compiler, expr));
+		break;
+	case EXPR_MAP:
+		compile_map(compiler, (MapExpr *)expr);
+		break;
+	case EXPR_SEQUENCE: {
+		SequenceExpr *seq = (SequenceExpr *)expr;
+		compile_sequence(compiler, seq);
+		emit_op_operand(compiler, OP_TUPLE, 1 - (int)seq->seq.size, seq->seq.size);
+		break;
+	}
+	case EXPR_GROUPING:
+		compile_expr(compiler, ((GroupingExpr *)expr)->expr);
+		break;
+	case EXPR_CAST:
+		compile_cast(compiler, (CastExpr *)expr);
+		break;
+	case EXPR_CALL:
+		compile_call(compiler, (CallExpr *)expr);
+		break;
+	/* subshells and anything else is left to the tree-walker */
+	default:
+		emit_eval_expr(compiler, expr);
+	}
+}
+
+
+/*
+ * statements
+ */
+static void compile_block_body(Compiler *compiler, BlockStmt *stmt)
+{
+	LLItem *item;
+	ARENA_LL_FOR_EACH(stmt->statements, item)
+	{
+		compile_stmt(compiler, item->value);
+	}
+}
+
+static void push_scope(Compiler *compiler)
+{
+	/* the slot layout is patched in when the scope ends */
+	emit_op(compiler, OP_PUSH_SCOPE, 0);
+	emit(compiler, 0);
+	emit(compiler, 0);
+	compiler->scope_depth++;
+	begin_scope(compiler, compiler->chunk->len - 2);
+}
+
+static void pop_scope(Compiler *compiler)
+{
+	size_t operand_pos = current_scope(compiler)->operand_pos;
+	compiler->chunk->code[operand_pos] = current_scope(compiler)->names.size;
+	compiler->chunk->code[operand_pos + 1] = end_scope(compiler);
+	emit_op(compiler, OP_POP_SCOPE, 0);
+	compiler->scope_depth--;
+}
+
+static void compile_block(Compiler *compiler, BlockStmt *stmt)
+{
+	push_scope(compiler);
+	compile_block_body(compiler, stmt);
+	pop_scope(compiler);
+}
+
+static void compile_var(Compiler *compiler, VarStmt *stmt)
+{
+	compile_expr(compiler, stmt->initializer);
+	emit_op_operand(compiler, OP_DEFINE_LOCAL, -1, declare_local(compiler, stmt->name));
+}
+
+static void compile_seq_var(Compiler *compiler, SeqVarStmt *stmt)
+{
+	SequenceExpr *initializer = (SequenceExpr *)stmt->initializer;
+	if (initializer->type == EXPR_SEQUENCE) {
+		if (stmt->names.size != initializer->seq.size) {
+			/* let the tree-walker report the error */
+			emit_exec_stmt(compiler, (Stmt *)stmt);
+			return;
+		}
+		LLItem *l = stmt->names.head;
+		LLItem *r = initializer->seq.head;
+		for (; l != NULL; l = l->next, r = r->next) {
+			compile_expr(compiler, r->value);
+			emit_op_operand(compiler, OP_DEFINE_LOCAL, -1,
+							declare_local(compiler, *(StrView *)l->value));
+		}
+		return;
+	}
+
+	size_t n = stmt->names.size;
+	compile_expr(compiler, stmt->initializer);
+	emit_op_operand(compiler, OP_UNPACK, (int)n - 1, n);
+	/* The last item is on top of the stack, so define the names in reverse order */
+	uint32_t slots[n];
+	size_t i = 0;
+	LLItem *item;
+	ARENA_LL_FOR_EACH(&stmt->names, item)
+	{
+		slots[i++] = declare_local(compiler, *(StrView *)item->value);
+	}
+	while (i > 0)
+		emit_op_operand(compiler, OP_DEFINE_LOCAL, -1, slots[--i]);
+}
+
+static void compile_assign(Compiler *compiler, AssignStmt *stmt)
+{
+	if (stmt->var->type == EXPR_SUBSCRIPT) {
+		SubscriptExpr *subscript = (SubscriptExpr *)stmt->var;
+		/* this would mean assigning to an inline variable which would do nothing */
+		if (subscript->expr->type != EXPR_ACCESS)
+			return;
+		compile_expr(compiler, subscript->access_value);
+		compile_expr(compiler, stmt->value);
+		emit_op(compiler, OP_SUBSCRIPT_ASSIGN, -2);
+		emit(compiler, add_name(compiler, &((AccessExpr *)subscript->expr)->var_name));
+		emit(compiler, stmt->assignment_op);
+		return;
+	}
+
+	if (stmt->var->type == EXPR_SEQUENCE) {
+		SequenceExpr *left = (SequenceExpr *)stmt->var;
+		SequenceExpr *right = (SequenceExpr *)stmt->value;
+		bool can_compile = right->type == EXPR_SEQUENCE && left->seq.size == right->seq.size;
+		LLItem *item;
+		ARENA_LL_FOR_EACH(&left->seq, item)
+		{
+			can_compile = can_compile && ((Expr *)item->value)->type == EXPR_ACCESS;
+		}
+		if (!can_compile) {
+			/* let the tree-walker report the error */
+			emit_exec_stmt(compiler, (Stmt *)stmt);
+			return;
+		}
+
+		/* early eval all values on the right side of assignment, then assign in reverse order */
+		compile_sequence(compiler, right);
+		StrView *names[left->seq.size];
+		size_t i = 0;
+		ARENA_LL_FOR_EACH(&left->seq, item)
+		{
+			names[i++] = &((AccessExpr *)item->value)->var_name;
+		}
+		while (i > 0)
+			emit_set_var(compiler, names[--i]);
+		return;
+	}
+
+	if (stmt->var->type != EXPR_ACCESS) {
+		emit_exec_stmt(compiler, (Stmt *)stmt);
+		return;
+	}
+
+	StrView *name = &((AccessExpr *)stmt->var)->var_name;
+	if (stmt->assignment_op == t_equal) {
+		compile_expr(compiler, stmt->value);
+	} else {
+		emit_get_var(compiler, name);
+		compile_expr(compiler, stmt->value);
+		emit_binary_op(compiler, stmt->assignment_op);
+	}
+	emit_set_var(compiler, name);
+}
+
+static void compile_if(Compiler *compiler, IfStmt *stmt)
+{
+	compile_expr(compiler, stmt->condition);
+	size_t else_jump = emit_jump(compiler, OP_JUMP_IF_FALSE);
+	compile_stmt(compiler, stmt->then_branch);
+	if (stmt->else_branch == NULL) {
+		patch_jump(compiler, else_jump);
+		return;
+	}
+	size_t end_jump = emit_jump(compiler, OP_JUMP);
+	patch_jump(compiler, else_jump);
+	compile_stmt(compiler, stmt->else_branch);
+	patch_jump(compiler, end_jump);
+}
+
+static void loop_begin(Compiler *compiler, LoopCtx *loop)
+{
+	loop->enclosing = compiler->loop;
+	loop->scope_depth = compiler->scope_depth;
+	arraylist_init(&loop->breaks, sizeof(size_t));
+	arraylist_init(&loop->continues, sizeof(size_t));
+	compiler->loop = loop;
+}
+
+static void loop_patch_jumps(Compiler *compiler, ArrayList *jumps)
+{
+	for (size_t i = 0; i < jumps->size; i++)
+		patch_jump(compiler, *(size_t *)arraylist_get(jumps, i));
+}
+
+static void loop_end(Compiler *compiler, LoopCtx *loop)
+{
+	arraylist_free(&loop->breaks);
+	arraylist_free(&loop->continues);
+	compiler->loop = loop->enclosing;
+}
+
+static void compile_loop(Compiler *compiler, LoopStmt *stmt)
+{
+	LoopCtx loop;
+	push_scope(compiler);
+	loop_begin(compiler, &loop);
+
+	size_t loop_start = compiler->chunk->len;
+	compiler->prev_line = -1;
+	compile_expr(compiler, stmt->condition);
+	size_t exit_jump = emit_jump(compiler, OP_JUMP_IF_FALSE);
+	compile_block_body(compiler, stmt->body_block);
+
+	loop_patch_jumps(compiler, &loop.continues);
+	emit_op(compiler, OP_RESET_SCOPE, 0);
+	emit_loop(compiler, loop_start);
+
+	patch_jump(compiler, exit_jump);
+	loop_patch_jumps(compiler, &loop.breaks);
+	loop_end(compiler, &loop);
+	pop_scope(compiler);
+}
+
+static void compile_iter_loop(Compiler *compiler, IterLoopStmt *stmt)
+{
+	LoopCtx loop;
+	/*
+	 * Iterate over the output of a subshell while it runs instead of capturing it first.
+	 * Evaluated outside the loop scope so a builtin in the subshell defines in the enclosing scope.
+	 */
+	if (stmt->underlying_iterable->type == EXPR_SUBSHELL)
+		emit_op_operand(compiler, OP_LINE_STREAM, 1, add_node(compiler, stmt->underlying_iterable));
+	else
+		compile_expr(compiler, stmt->underlying_iterable);
+	push_scope(compiler);
+	/* [iterable] -> [iterable, items, index] */
+	emit_op(compiler, OP_ITER_INIT, 2);
+	loop_begin(compiler, &loop);
+
+	size_t loop_start = compiler->chunk->len;
+	compiler->prev_line = -1;
+	emit_op_operand(compiler, OP_ITER_NEXT, 0, declare_local(compiler, stmt->var_name));
+	emit(compiler, 0);
+	size_t exit_jump = compiler->chunk->len - 1;
+	compile_block_body(compiler, stmt->body_block);
+
+	loop_patch_jumps(compiler, &loop.continues);
+	emit_op(compiler, OP_RESET_SCOPE, 0);
+	emit_loop(compiler, loop_start);
+
+	patch_jump(compiler, exit_jump);
+	loop_patch_jumps(compiler, &loop.breaks);
+	loop_end(compiler, &loop);
+	pop_scope(compiler);
+	emit_op(compiler, OP_ITER_END, -3);
+}
+
+static void compile_andor(Compiler *compiler, BinaryStmt *stmt)
+{
+	/*
+	 * L ( "&&" | "||" ) R.
+	 * If L is an expression statement then we use the result of expression statement
+	 * instead of the previous exit code.
+	 */
+	if (stmt->left->type == STMT_EXPRESSION) {
+		compile_expr(compiler, ((ExpressionStmt *)stmt->left)->expression);
+	} else {
+		compile_stmt(compiler, stmt->left);
+		emit_op(compiler, OP_EXIT_CODE, 1);
+	}
+
+	size_t end_jump =
+		emit_jump(compiler, stmt->operator_ == t_anp_anp ? OP_JUMP_IF_FALSE : OP_JUMP_IF_TRUE);
+	compile_stmt(compiler, stmt->right_stmt);
+	patch_jump(compiler, end_jump);
+}
+
+static void compile_abrupt_control_flow(Compiler *compiler, AbruptControlFlowStmt *stmt)
+{
+	LoopCtx *loop = compiler->loop;
+	if (stmt->ctrlf_type != t_return && loop != NULL) {
+		/* unwind any scopes opened inside the loop body */
+		for (size_t i = loop->scope_depth; i < compiler->scope_depth; i++)
+			emit(compiler, OP_POP_SCOPE);
+		size_t jump = emit_jump(compiler, OP_JUMP);
+		arraylist_append(stmt->ctrlf_type == t_break ? &loop->breaks : &loop->continues, &jump);
+		return;
+	}
+
+	/* break, continue and return at the top-level do nothing */
+	if (!compiler->in_function)
+		return;
+
+	/* break or continue outside of a loop returns None from the function */
+	if (stmt->ctrlf_type == t_return && stmt->return_expr != NULL)
+		compile_expr(compiler, stmt->return_expr);
+	else
+		emit_op(compiler, OP_NONE, 1);
+	emit_op(compiler, OP_RETURN, -1);
+}
+
+static void compile_stmt(Compiler *compiler, Stmt *stmt)
+{
+	switch (stmt->type) {
+	case STMT_VAR:
+		compile_var(compiler, (VarStmt *)stmt);
+		break;
+	case STMT_SEQ_VAR:
+		compile_seq_var(compiler, (SeqVarStmt *)stmt);
+		break;
+	case STMT_EXPRESSION: {
+		Expr *expr = ((ExpressionStmt *)stmt)->expression;
+		compile_expr(compiler, expr);
+		emit_op(compiler, expr->type == EXPR_CALL ? OP_POP : OP_PRINT, -1);
+		break;
+	}
+	case STMT_LOOP:
+		compile_loop(compiler, (LoopStmt *)stmt);
+		break;
+	case STMT_ITER_LOOP:
+		compile_iter_loop(compiler, (IterLoopStmt *)stmt);
+		break;
+	case STMT_IF:
+		compile_if(compiler, (IfStmt *)stmt);
+		break;
+	case STMT_BLOCK:
+		compile_block(compiler, (BlockStmt *)stmt);
+		break;
+	case STMT_ASSIGN:
+		compile_assign(compiler, (AssignStmt *)stmt);
+		break;
+	case STMT_ASSERT:
+		compile_expr(compiler, ((AssertStmt *)stmt)->expr);
+		emit_op(compiler, OP_ASSERT, -1);
+		break;
+	case STMT_BINARY:
+		if (((BinaryStmt *)stmt)->operator_ == t_anp_anp ||
+			((BinaryStmt *)stmt)->operator_ == t_pipe_pipe)
+			compile_andor(compiler, (BinaryStmt *)stmt);
+		else
+			emit_exec_stmt(compiler, stmt);
+		break;
+	case STMT_ABRUPT_CONTROL_FLOW:
+		compile_abrupt_control_flow(compiler, (AbruptControlFlowStmt *)stmt);
+		break;
+	/* commands, pipelines and redirections are left to the tree-walker */
+	default:
+		emit_exec_stmt(compiler, stmt);
+	}
+}
+
+static void compiler_init(Compiler *compiler, Chunk *chunk, StrPool *str_pool, Scope *globals)
+{
+	chunk_init(chunk);
+	*compiler = (Compiler){ .chunk = chunk,
+							.in_function = globals == NULL,
+							.globals = globals,
+							.str_pool = str_pool,
+							.scope_depth = 0,
+							.stack_depth = 0,
+							.loop = NULL,
+							.prev_line = -1 };
+	arraylist_init(&compiler->locals, sizeof(Local));
+	arraylist_init(&compiler->scopes, sizeof(CompilerScope));
+	begin_scope(compiler, 0);
+}
+
+static void compiler_finish(Compiler *compiler)
+{
+	emit_op(compiler, OP_NONE, 1);
+	emit_op(compiler, OP_RETURN, -1);
+	compiler->chunk->frame_slots = current_scope(compiler)->names.size;
+	compiler->chunk->frame_names = end_scope(compiler);
+	arraylist_free(&compiler->locals);
+	arraylist_free(&compiler->scopes);
+}
+
+void compile_program(Chunk *chunk, StrPool *str_pool, Scope *globals, ArrayList *statements)
+{
+	Compiler compiler;
+	compiler_init(&compiler, chunk, str_pool, globals);
+	for (size_t i = 0; i < statements->size; i++)
+		compile_stmt(&compiler, *(Stmt **)arraylist_get(statements, i));
+	compiler_finish(&compiler);
+}
+
+void compile_function(Chunk *chunk, StrPool *str_pool, ArenaLL *params, BlockStmt *body)
+{
+	Compiler compiler;
+	compiler_init(&compiler, chunk, str_pool, NULL);
+	/* parameters occupy the first slots of the frame */
+	LLItem *item;
+	ARENA_LL_FOR_EACH(params, item)
+	{
+		StrView name = *(StrView *)item->value;
+		CompilerScope *frame = current_scope(&compiler);
+		add_local(&compiler, name, frame->names.size);
+		arraylist_append(&frame->names, &name);
+	}
+	compile_block_body(&compiler, body);
+	compiler_finish(&compiler);
+}
@@ -22,6 +22,7 @@
 #include <string.h>
 
 #include "interpreter/error.h"
+#include "interpreter/interpreter.h"
 #include "interpreter/lexer.h"
 #include "interpreter/parser.h"
 #include "nicc/nicc.h"
@@ -34,6 +35,7 @@ typedef struct {
 } ErrBuf;
 
 jmp_buf runtime_error_jmp = { 0 };
+StreamCtx *runtime_error_stream_ctx = NULL;
 
 
 static char *offending_line(char *src, size_t line_no)
@@ -141,3 +143,9 @@ void report_parse_err(ParseError *error, char *full_input)
 	err_buf_print(bf, error->failed->end - failed->start);
 	free(bf.alloced_buffer);
 }
+
+void runtime_error_flush(void)
+{
+	if (runtime_error_stream_ctx != NULL)
+		stream_ctx_flush(runtime_error_stream_ctx);
+}
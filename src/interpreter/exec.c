@@ -14,6 +14,10 @@
  *  You should have received a copy of the GNU General Public License
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#define _GNU_SOURCE // posix_spawn_file_actions_addtcsetpgrp_np, if glibc has it
+#include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -22,9 +26,17 @@
 #include <stdio.h>
 #endif /* EXEC_DEBUG */
 
+#include "interpreter/exec.h"
 #include "interpreter/interpreter.h"
 #include "nicc/nicc.h"
 
+/* glibc 2.35 added the file action that gives the terminal to the group of the spawned program */
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ(2, 35)
+#define SPAWN_CAN_GIVE_TERMINAL
+#endif
+#endif
+
 
 extern char **environ;
 
@@ -37,32 +49,155 @@ static void close_active_fds(ArrayList *active_fds)
 	}
 }
 
-int exec_program(StreamCtx *stream_ctx, char **argv)
+static void debug_print_argv(char **argv)
 {
 #ifdef EXEC_DEBUG
-	char **argv_cpy = argv;
-	for (char *argv_cur = *argv_cpy; argv_cur != NULL;) {
-		printf("'%s'\n", argv_cur);
-		argv_cpy++;
-		argv_cur = *argv_cpy;
-	}
+	for (char **argv_cur = argv; *argv_cur != NULL; argv_cur++)
+		printf("'%s'\n", *argv_cur);
+#else
+	(void)argv;
 #endif /* EXEC_DEBUG */
+}
 
-	int status;
-	pid_t new_pid = fork();
-	if (new_pid == 0) {
-		if (stream_ctx->in_fd != STDIN_FILENO) {
-			dup2(stream_ctx->in_fd, STDIN_FILENO);
-		}
-		if (stream_ctx->out_fd != STDOUT_FILENO) {
-			dup2(stream_ctx->out_fd, STDOUT_FILENO);
-		}
+static int exit_code_from_status(int status)
+{
+	if (WIFSIGNALED(status))
+		return 128 + WTERMSIG(status);
+	return WEXITSTATUS(status);
+}
+
+/*
+ * Programs are started with posix_spawn() rather than fork() followed by execve(). glibc spawns
+ * with clone(CLONE_VM | CLONE_VFORK), so the cost does not depend on the size of the GC heap like
+ * copying the page tables in fork() does.
+ * Returns 0 or the error that prevented the program from being started.
+ */
+static int spawn(StreamCtx *stream_ctx, char **argv, pid_t *pid, bool in_group, pid_t pgid,
+				 bool foreground)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+#ifdef SPAWN_CAN_GIVE_TERMINAL
+	/* file actions run in order, so this must happen while stdin still is the terminal */
+	if (in_group && foreground)
+		posix_spawn_file_actions_addtcsetpgrp_np(&actions, STDIN_FILENO);
+#else
+	(void)foreground;
+#endif
+	if (stream_ctx->in_fd != STDIN_FILENO)
+		posix_spawn_file_actions_adddup2(&actions, stream_ctx->in_fd, STDIN_FILENO);
+	if (stream_ctx->out_fd != STDOUT_FILENO)
+		posix_spawn_file_actions_adddup2(&actions, stream_ctx->out_fd, STDOUT_FILENO);
+	for (size_t i = 0; i < stream_ctx->active_fds.size; i++) {
+		int *fd = arraylist_get(&stream_ctx->active_fds, i);
+		posix_spawn_file_actions_addclose(&actions, *fd);
+	}
+
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+	if (in_group) {
+		/* slash may ignore job control signals, but the programs it starts should not */
+		sigset_t default_signals;
+		sigemptyset(&default_signals);
+		sigaddset(&default_signals, SIGTTOU);
+		sigaddset(&default_signals, SIGTTIN);
+		sigaddset(&default_signals, SIGTSTP);
+		posix_spawnattr_setsigdefault(&attr, &default_signals);
+		posix_spawnattr_setpgroup(&attr, pgid);
+		posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF);
+	}
+
+	int rc = posix_spawn(pid, argv[0], &actions, &attr, argv, environ);
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+	return rc;
+}
+
+int exec_program(StreamCtx *stream_ctx, char **argv)
+{
+	debug_print_argv(argv);
+	/* output from slash must come before any output from the program */
+	stream_ctx_flush(stream_ctx);
 
-		close_active_fds(&stream_ctx->active_fds);
-		execve(argv[0], argv, environ);
+	pid_t new_pid;
+	if (spawn(stream_ctx, argv, &new_pid, false, 0, false) != 0)
+		return 127;
+	return exec_wait(new_pid);
+}
+
+pid_t exec_fork_in_group(StreamCtx *stream_ctx, pid_t pgid, bool foreground)
+{
+	/* the child would otherwise write the buffered output a second time */
+	stream_ctx_flush(stream_ctx);
+	pid_t new_pid = fork();
+	if (new_pid != 0) {
+		/* set the group in both processes so it is in place no matter who runs first */
+		setpgid(new_pid, pgid == 0 ? new_pid : pgid);
+		return new_pid;
 	}
 
+	setpgid(0, pgid);
+	if (foreground)
+		exec_give_terminal(pgid == 0 ? getpid() : pgid);
+	/* slash may ignore job control signals, but the programs it starts should not */
+	signal(SIGTTOU, SIG_DFL);
+	signal(SIGTTIN, SIG_DFL);
+	signal(SIGTSTP, SIG_DFL);
+
+	if (stream_ctx->in_fd != STDIN_FILENO)
+		dup2(stream_ctx->in_fd, STDIN_FILENO);
+	if (stream_ctx->out_fd != STDOUT_FILENO)
+		dup2(stream_ctx->out_fd, STDOUT_FILENO);
 	close_active_fds(&stream_ctx->active_fds);
-	waitpid(new_pid, &status, 0);
-	return WEXITSTATUS(status);
+	stream_ctx->in_fd = STDIN_FILENO;
+	stream_ctx->out_fd = STDOUT_FILENO;
+	return 0;
+}
+
+pid_t exec_program_async(StreamCtx *stream_ctx, char **argv, pid_t pgid, bool foreground)
+{
+	debug_print_argv(argv);
+	stream_ctx_flush(stream_ctx);
+
+	pid_t new_pid;
+#ifndef SPAWN_CAN_GIVE_TERMINAL
+	/* the program must not run before it has the terminal, so it has to be forked */
+	if (foreground) {
+		new_pid = exec_fork_in_group(stream_ctx, pgid, foreground);
+		if (new_pid == 0) {
+			execve(argv[0], argv, environ);
+			_exit(127);
+		}
+		return new_pid;
+	}
+#endif
+	/* posix_spawn() returns once the program is executing, so the group is already in place */
+	if (spawn(stream_ctx, argv, &new_pid, true, pgid, foreground) == 0)
+		return new_pid;
+
+	/* the pipeline still needs a process, so fall back to one that fails like execve() would */
+	new_pid = exec_fork_in_group(stream_ctx, pgid, foreground);
+	if (new_pid == 0)
+		_exit(127);
+	return new_pid;
+}
+
+int exec_wait(pid_t pid)
+{
+	int status;
+	waitpid(pid, &status, 0);
+	return exit_code_from_status(status);
+}
+
+bool exec_owns_terminal(void)
+{
+	return isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == getpgrp();
+}
+
+void exec_give_terminal(pid_t pgid)
+{
+	/* tcsetpgrp() from a background process group raises SIGTTOU unless it is ignored */
+	void (*og_handler)(int) = signal(SIGTTOU, SIG_IGN);
+	tcsetpgrp(STDIN_FILENO, pgid);
+	signal(SIGTTOU, og_handler);
 }
@@ -15,11 +15,18 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <assert.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "interpreter/error.h"
 #include "interpreter/gc.h"
+#include "interpreter/interpreter.h"
+#include "interpreter/line_stream.h"
 #include "interpreter/scope.h"
 #include "interpreter/value/slash_list.h"
 #include "interpreter/value/slash_map.h"
@@ -33,6 +40,13 @@
 #endif /* DEBUG_LOG_GC */
 
 
+static double gc_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
 static void gc_sweep_obj(Interpreter *interpreter, SlashObj *obj)
 {
 	SlashValue value = AS_VALUE(obj);
@@ -44,61 +58,257 @@ static void gc_sweep_obj(Interpreter *interpreter, SlashObj *obj)
 		SlashTuple *tuple = AS_TUPLE(value);
 		gc_free(interpreter, tuple->items, tuple->len * sizeof(SlashValue));
 	} else if (IS_STR(value)) {
-		SlashStr *str = AS_STR(value);
-		gc_free(interpreter, str->str, str->len + 1);
+		slash_str_free(interpreter, AS_STR(value));
+		/* the characters may be allocated together with the str */
+		gc_free(interpreter, obj, slash_str_obj_size(AS_STR(value)));
+		return;
+	} else if (IS_RANGE(value)) {
+		/* nothing owned by the range */
+	} else if (IS_LINE_STREAM(value)) {
+		line_stream_free(interpreter, AS_LINE_STREAM(value));
 	} else {
 		REPORT_RUNTIME_ERROR("Sweep not implemented for this obj");
 	}
 
-	gc_free(interpreter, obj, value.T->obj_size);
+	gc_free(interpreter, obj, TYPE_OF(value)->obj_size);
+}
+
+static bool gc_is_container(SlashObj *obj)
+{
+	return obj->T == &list_type_info || obj->T == &tuple_type_info || obj->T == &map_type_info;
+}
+
+/* Keeps obj in the remembered set for at least the next n collections */
+static void gc_remember(GC *gc, SlashObj *obj, uint8_t n)
+{
+	if (obj->gc_remembered == 0)
+		arraylist_append(&gc->remembered, &obj);
+	if (obj->gc_remembered < n)
+		obj->gc_remembered = n;
 }
 
-static void gc_sweep(Interpreter *interpreter)
+/*
+ * Drops objects from the remembered set once the young objects they may reference are either
+ * promoted or freed, which takes at most two collections.
+ * On a major collection, unmarked objects are dropped as they are about to be swept.
+ */
+static void gc_age_remembered(GC *gc)
 {
-	LinkedListItem *to_remove = NULL;
-	LinkedListItem *current = interpreter->gc.gc_objs.head;
+	SlashObj **remembered = (SlashObj **)gc->remembered.data;
+	size_t kept = 0;
+	for (size_t i = 0; i < gc->remembered.size; i++) {
+		SlashObj *obj = remembered[i];
+		if (!gc->minor && obj->gc_marked != gc->mark_epoch)
+			continue;
+		if (--obj->gc_remembered != 0)
+			remembered[kept++] = obj;
+	}
+	gc->remembered.size = kept;
+}
 
-	while (current != NULL) {
-		SlashObj *obj = current->data;
-		if (!obj->gc_marked && obj->gc_managed) {
 #ifdef DEBUG_LOG_GC
-			printf("%p sweep ", (void *)obj);
-			TraitPrint print_func = obj->T->print;
-			assert(print_func != NULL);
-			SlashValue value = AS_VALUE(obj);
-			print_func(interpreter, value);
-			putchar('\n');
+static void gc_log_sweep(Interpreter *interpreter, SlashObj *obj)
+{
+	printf("%p sweep ", (void *)obj);
+	TraitPrint print_func = obj->T->print;
+	assert(print_func != NULL);
+	SlashValue value = AS_VALUE(obj);
+	print_func(interpreter, value);
+	putchar('\n');
+}
 #endif
-			gc_sweep_obj(interpreter, obj);
-			to_remove = current;
-			current = current->next;
-			linkedlist_remove_item(&interpreter->gc.gc_objs, to_remove);
+
+void gc_tmp_begin(GC *gc, Arena *arena)
+{
+	assert(gc->tmp_arena == NULL);
+	gc->tmp_arena = arena;
+}
+
+void gc_tmp_end(GC *gc)
+{
+	gc->tmp_arena = NULL;
+}
+
+void gc_set_next_run(GC *gc)
+{
+	gc->next_run = (size_t)(gc->bytes_managing * gc->heap_grow_factor);
+	if (gc->min_run > gc->next_run)
+		gc->next_run = gc->min_run;
+	/* leave half of the room under the limit for the incremental marking to finish in */
+	if (gc->max_heap != 0 && gc->bytes_managing < gc->max_heap) {
+		size_t limit_run = gc->bytes_managing + (gc->max_heap - gc->bytes_managing) / 2;
+		if (gc->next_run > limit_run)
+			gc->next_run = limit_run;
+	}
+}
+
+void gc_set_mark_threads(GC *gc, size_t n)
+{
+	if (n > GC_MARK_THREADS_MAX)
+		n = GC_MARK_THREADS_MAX;
+	gc->mark_threads = n == 0 ? 1 : n;
+}
+
+/*
+ * Called when a major collection is fully swept.
+ * The work of a major collection is proportional to the live heap, and the headroom above the
+ * live heap decides how often it runs. The headroom is therefore scaled by how far the time spent
+ * on major collections since the previous one is from the overhead target. Minor collections do
+ * not depend on the headroom, so their time only counts as not running the program.
+ */
+static void gc_adapt_grow_factor(GC *gc)
+{
+	double now = gc_now();
+	double gc_time = gc->pause_total - gc->cycle_pause_start;
+	double major_time = gc_time - (gc->minor_pause_total - gc->cycle_minor_pause_start);
+	double mutator_time = now - gc->cycle_start - gc_time;
+	gc->overhead = mutator_time > 0 ? major_time / mutator_time : 0;
+	gc->survival = gc->bytes_before_major == 0 ?
+					   0 :
+					   1 - (double)gc->bytes_freed_major / gc->bytes_before_major;
+	gc->cycle_start = now;
+	gc->cycle_pause_start = gc->pause_total;
+	gc->cycle_minor_pause_start = gc->minor_pause_total;
+	if (!gc->adaptive)
+		return;
+
+	double scale = gc->overhead / gc->overhead_target;
+	/* a collection that freed next to nothing should not make the next one come sooner */
+	if (gc->survival > GC_HIGH_SURVIVAL && scale < 1)
+		scale = 1;
+	if (scale > 2)
+		scale = 2;
+	else if (scale < 0.5)
+		scale = 0.5;
+
+	gc->heap_grow_factor = 1 + (gc->heap_grow_factor - 1) * scale;
+	if (gc->heap_grow_factor > GC_GROW_FACTOR_MAX)
+		gc->heap_grow_factor = GC_GROW_FACTOR_MAX;
+	else if (gc->heap_grow_factor < GC_GROW_FACTOR_MIN)
+		gc->heap_grow_factor = GC_GROW_FACTOR_MIN;
+}
+
+/*
+ * Sweeps at most budget old objects, starting where the previous call stopped.
+ * Returns true once the whole old generation is swept.
+ * The epoch is flipped when a major collection finishes marking, so the unreachable objects are
+ * the ones that are marked in the current epoch. Minor collections and the write barrier do not
+ * mark old objects, and objects promoted meanwhile are put in front of the sweep.
+ */
+static bool gc_sweep_old(Interpreter *interpreter, size_t budget)
+{
+	GC *gc = &interpreter->gc;
+	size_t pre = gc->bytes_managing;
+	for (size_t swept = 0; *gc->sweep_link != NULL; swept++) {
+		if (swept >= budget) {
+			gc->bytes_freed_major += pre - gc->bytes_managing;
+			return false;
+		}
+		SlashObj *obj = *gc->sweep_link;
+		if (obj->gc_marked != gc->mark_epoch) {
+			gc->sweep_link = &obj->gc_next;
 			continue;
 		}
+#ifdef DEBUG_LOG_GC
+		gc_log_sweep(interpreter, obj);
+#endif
+		*gc->sweep_link = obj->gc_next;
+		gc->objs_len--;
+		gc_sweep_obj(interpreter, obj);
+	}
 
-		current = current->next;
+	gc->bytes_freed_major += pre - gc->bytes_managing;
+	gc->sweep_link = NULL;
+	gc_pool_release_empty(&gc->pool);
+	gc_adapt_grow_factor(gc);
+	gc_set_next_run(gc);
+	return true;
+}
+
+/* Sweeps what is left of the old generation from the previous major collection */
+static void gc_sweep_old_finish(Interpreter *interpreter)
+{
+	if (interpreter->gc.sweep_link != NULL)
+		gc_sweep_old(interpreter, SIZE_MAX);
+}
+
+/*
+ * Young objects allocated since the previous collection are created marked and therefore kept.
+ * The remaining young objects are freed if unmarked and promoted otherwise. Objects promoted by the
+ * write barrier are never marked by a minor collection, but survive it.
+ * A minor collection does not flip the epoch, so the survivors are unmarked here.
+ */
+static void gc_sweep_young(Interpreter *interpreter)
+{
+	GC *gc = &interpreter->gc;
+	size_t pre = gc->bytes_managing;
+	SlashObj **link = &gc->objs;
+	while (*link != gc->objs_traced) {
+		if (gc->minor)
+			(*link)->gc_marked = !gc->mark_epoch;
+		link = &(*link)->gc_next;
 	}
+
+	SlashObj *obj = *link;
+	*link = NULL;
+	while (obj != NULL) {
+		SlashObj *next = obj->gc_next;
+		if (obj->gc_marked != gc->mark_epoch && !(gc->minor && obj->gc_old)) {
+#ifdef DEBUG_LOG_GC
+			gc_log_sweep(interpreter, obj);
+#endif
+			gc->objs_len--;
+			gc_sweep_obj(interpreter, obj);
+		} else {
+			if (gc->minor)
+				obj->gc_marked = !gc->mark_epoch;
+			obj->gc_old = true;
+			obj->gc_next = gc->old_objs;
+			gc->old_objs = obj;
+			/* may still reference objects that were allocated after it */
+			if (gc_is_container(obj))
+				gc_remember(gc, obj, 1);
+		}
+		obj = next;
+	}
+
+	if (gc->minor)
+		gc->bytes_freed_minor = pre - gc->bytes_managing;
+	else
+		gc->bytes_freed_major += pre - gc->bytes_managing;
 }
 
 static void gc_reset(GC *gc)
 {
-	gc->next_run = gc->bytes_managing * GC_HEAP_GROW_FACTOR;
-	if (GC_MIN_RUN > gc->next_run)
-		gc->next_run = GC_MIN_RUN;
-
-	for (LinkedListItem *item = gc->gc_objs.head; item != NULL; item = item->next) {
-		SlashObj *obj = item->data;
-		obj->gc_marked = false;
+	if (!gc->minor) {
+		/* every survivor is unmarked in the next epoch */
+		gc->mark_epoch = !gc->mark_epoch;
+		/* the old generation is swept by later allocations, next_run is set once it is done */
+		gc->sweep_link = &gc->old_objs;
+		gc->next_run = SIZE_MAX;
 	}
+	gc->objs_traced = gc->objs;
+	gc->new_containers.size = 0;
+	gc->bytes_since_run = 0;
+	gc->minor = false;
 }
 
-static void gc_visit_obj(Interpreter *interpreter, SlashObj *obj)
+/* Marks obj and pushes it on the gray stack given, unless it is already marked */
+static void gc_visit_obj(Interpreter *interpreter, ArrayList *gray, SlashObj *obj)
 {
 	assert(obj != NULL);
-	if (obj->gc_marked)
+	GC *gc = &interpreter->gc;
+	if (obj->gc_marked == gc->mark_epoch || (gc->minor && obj->gc_old))
 		return;
-	obj->gc_marked = true;
-	arraylist_append(&interpreter->gc.gray_stack, &obj);
+	if (gc->mark_parallel) {
+		/* another marker may have claimed the object since it was read */
+		bool marked = __atomic_exchange_n(&obj->gc_marked, gc->mark_epoch, __ATOMIC_RELAXED);
+		if (marked == gc->mark_epoch)
+			return;
+	} else {
+		obj->gc_marked = gc->mark_epoch;
+	}
+	arraylist_append(gray, &obj);
 
 #ifdef DEBUG_LOG_GC
 	printf("%p mark ", (void *)obj);
@@ -110,13 +320,14 @@ static void gc_visit_obj(Interpreter *interpreter, SlashObj *obj)
 #endif
 }
 
-static void gc_visit_value(Interpreter *interpreter, SlashValue *value)
+static void gc_visit_value(Interpreter *interpreter, ArrayList *gray, SlashValue *value)
 {
-	if (IS_OBJ(*value) && value->obj->gc_managed)
-		gc_visit_obj(interpreter, value->obj);
+	if (IS_OBJ(*value) && AS_OBJ(*value)->gc_managed)
+		gc_visit_obj(interpreter, gray, AS_OBJ(*value));
 }
 
-static void gc_blacken_obj(Interpreter *interpreter, SlashObj *obj)
+/* Pushes the unmarked objects obj references on gray. Returns how many values were traced */
+static size_t gc_blacken_obj(Interpreter *interpreter, ArrayList *gray, SlashObj *obj)
 {
 	SlashValue value = AS_VALUE(obj);
 	(void)value;
@@ -131,99 +342,392 @@ static void gc_blacken_obj(Interpreter *interpreter, SlashObj *obj)
 
 	if (IS_MAP(value)) {
 		SlashMap *map = AS_MAP(value);
-		if (map->len == 0)
-			return;
-		/* TODO: VLA bad ?! */
-		SlashValue keys[map->len];
-		slash_map_impl_get_keys(map, keys);
-		for (size_t i = 0; i < map->len; i++) {
-			gc_visit_value(interpreter, &keys[i]);
-			SlashValue v = slash_map_impl_get(map, keys[i]);
-			gc_visit_value(interpreter, &v);
+		/* walk the entries in place, stopping once every entry is found */
+		size_t found = 0;
+		size_t i = 0;
+		for (; i < N_BUCKETS(map->total_buckets_log2) && found < map->len; i++) {
+			SlashMapEntry *entries = map->buckets[i].entries;
+			for (size_t j = 0; j < HM_BUCKET_SIZE; j++) {
+				if (!entries[j].is_occupied)
+					continue;
+				found++;
+				gc_visit_value(interpreter, gray, &entries[j].key);
+				gc_visit_value(interpreter, gray, &entries[j].value);
+			}
 		}
+		return 1 + i * HM_BUCKET_SIZE;
 	} else if (IS_LIST(value)) {
 		SlashList *list = AS_LIST(value);
 		for (size_t i = 0; i < list->len; i++) {
 			SlashValue v = slash_list_impl_get(list, i);
-			gc_visit_value(interpreter, &v);
+			gc_visit_value(interpreter, gray, &v);
 		}
+		return 1 + list->len;
 	} else if (IS_TUPLE(value)) {
 		SlashTuple *tuple = AS_TUPLE(value);
 		for (size_t i = 0; i < tuple->len; i++)
-			gc_visit_value(interpreter, &tuple->items[i]);
-	} else if (IS_STR(value)) {
-		return;
+			gc_visit_value(interpreter, gray, &tuple->items[i]);
+		return 1 + tuple->len;
+	} else if (IS_STR(value) || IS_RANGE(value) || IS_LINE_STREAM(value)) {
+		return 1;
 	} else {
 		REPORT_RUNTIME_ERROR("gc blacken not implemented for this object type");
 	}
+	return 1;
 }
 
-static void gc_mark_roots(Interpreter *interpreter)
+/*
+ * Roots are scanned once when a collection begins. An incremental major collection scans them again
+ * when it finishes, as the mutator changes roots and fills containers in the shadow stack without
+ * the write barrier. Marked containers in the shadow stack are traced again for the same reason.
+ */
+static void gc_mark_roots(Interpreter *interpreter, bool remark)
 {
 	GC *gc = &interpreter->gc;
+	/* objects allocated since the previous collection are already marked, but not traced */
+	for (size_t i = 0; i < gc->new_containers.size; i++)
+		arraylist_append(&gc->gray_stack, arraylist_get(&gc->new_containers, i));
+
+	if (gc->minor) {
+		for (size_t i = 0; i < gc->remembered.size; i++)
+			arraylist_append(&gc->gray_stack, arraylist_get(&gc->remembered, i));
+	}
+
 	/* Mark all objects in shadow stack */
-	for (size_t i = 0; i < gc->shadow_stack.size; i++)
-		gc_visit_obj(interpreter, *(SlashObj **)arraylist_get(&gc->shadow_stack, i));
+	for (size_t i = 0; i < gc->shadow_stack.size; i++) {
+		SlashObj *obj = *(SlashObj **)arraylist_get(&gc->shadow_stack, i);
+		/* an old object in the shadow stack may be filled with young objects without a barrier */
+		if ((remark || (gc->minor && obj->gc_old)) && gc_is_container(obj))
+			arraylist_append(&gc->gray_stack, &obj);
+		else
+			gc_visit_obj(interpreter, &gc->gray_stack, obj);
+	}
+
+	/* Mark all values on the VM stack */
+	for (SlashValue *value = interpreter->vm.stack; value < interpreter->vm.sp; value++)
+		gc_visit_value(interpreter, &gc->gray_stack, value);
+
+	/* Mark the strs shared by str literals */
+	StrPool *str_pool = &interpreter->str_pool;
+	for (size_t i = 0; i < str_pool->all.size; i++) {
+		StrPoolEntry *entry = *(StrPoolEntry **)arraylist_get(&str_pool->all, i);
+		if (entry->str != NULL)
+			gc_visit_obj(interpreter, &gc->gray_stack, &entry->str->obj);
+	}
 
 	/* mark all reachable objects */
 	for (Scope *scope = interpreter->scope; scope != NULL; scope = scope->enclosing) {
-		/* loop over all values */
-		if (scope->values.len == 0)
-			continue;
-		// TODO: VLA bad
-		SlashValue *values[scope->values.len];
-		hashmap_get_values(&scope->values, (void **)values);
-
-		for (size_t i = 0; i < scope->values.len; i++)
-			gc_visit_value(interpreter, values[i]);
+		/* loop over all values. Undefined slots have no type and are therefore never objects */
+		for (size_t i = 0; i < scope->len; i++)
+			gc_visit_value(interpreter, &gc->gray_stack, &scope->values[i]);
 	}
 }
 
-static void gc_trace_references(Interpreter *interpreter)
+/*
+ * Traces gray objects until the gray stack is empty or at least budget values are traced.
+ * Returns true if the gray stack is empty.
+ */
+static bool gc_trace_references(Interpreter *interpreter, size_t budget)
 {
 	SlashObj *obj;
+	size_t traced = 0;
 	while (interpreter->gc.gray_stack.size != 0) {
+		if (traced >= budget)
+			return false;
 		arraylist_pop_and_copy(&interpreter->gc.gray_stack, &obj);
-		gc_blacken_obj(interpreter, obj);
+		traced += gc_blacken_obj(interpreter, &interpreter->gc.gray_stack, obj);
+	}
+	return true;
+}
+
+/*
+ * Parallel marking.
+ * Every marker traces from its own gray stack. A marker with a deep stack hands the bottom half of
+ * it over to the shared stack when another marker is out of work, and markers out of work take
+ * from the shared stack. Marking is done when every marker is out of work at the same time.
+ * The threads only live for one collection, so no marker threads exist when the shell forks.
+ */
+typedef struct {
+	Interpreter *interpreter;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	ArrayList shared; // gray objects handed over by markers with deep stacks
+	size_t n_markers;
+	size_t n_idle;
+	size_t n_waiting; // markers waiting for the shared stack to be filled
+} GCParallelMark;
+
+static void gc_mark_share(GCParallelMark *pm, ArrayList *gray)
+{
+	SlashObj **items = (SlashObj **)gray->data;
+	size_t half = gray->size / 2;
+	pthread_mutex_lock(&pm->lock);
+	for (size_t i = 0; i < half; i++)
+		arraylist_append(&pm->shared, &items[i]);
+	pthread_cond_broadcast(&pm->cond);
+	pthread_mutex_unlock(&pm->lock);
+	memmove(items, items + half, (gray->size - half) * sizeof(SlashObj *));
+	gray->size -= half;
+}
+
+/* Waits for gray objects to trace. Returns false once every marker is out of work */
+static bool gc_mark_take(GCParallelMark *pm, ArrayList *gray)
+{
+	pthread_mutex_lock(&pm->lock);
+	pm->n_idle++;
+	while (pm->shared.size == 0 && pm->n_idle < pm->n_markers) {
+		__atomic_add_fetch(&pm->n_waiting, 1, __ATOMIC_RELAXED);
+		pthread_cond_wait(&pm->cond, &pm->lock);
+		__atomic_sub_fetch(&pm->n_waiting, 1, __ATOMIC_RELAXED);
+	}
+	if (pm->shared.size == 0) {
+		pthread_cond_broadcast(&pm->cond);
+		pthread_mutex_unlock(&pm->lock);
+		return false;
+	}
+
+	size_t take = pm->shared.size < GC_MARK_SHARE_MIN ? pm->shared.size : GC_MARK_SHARE_MIN;
+	SlashObj **items = (SlashObj **)pm->shared.data;
+	for (size_t i = pm->shared.size - take; i < pm->shared.size; i++)
+		arraylist_append(gray, &items[i]);
+	pm->shared.size -= take;
+	pm->n_idle--;
+	pthread_mutex_unlock(&pm->lock);
+	return true;
+}
+
+static void gc_mark_run(GCParallelMark *pm, ArrayList *gray)
+{
+	SlashObj *obj;
+	do {
+		while (gray->size != 0) {
+			arraylist_pop_and_copy(gray, &obj);
+			gc_blacken_obj(pm->interpreter, gray, obj);
+			if (gray->size >= 2 * GC_MARK_SHARE_MIN &&
+				__atomic_load_n(&pm->n_waiting, __ATOMIC_RELAXED) != 0)
+				gc_mark_share(pm, gray);
+		}
+	} while (gc_mark_take(pm, gray));
+}
+
+static void *gc_mark_thread(void *arg)
+{
+	GCParallelMark *pm = arg;
+	ArrayList gray;
+	arraylist_init(&gray, sizeof(SlashObj *));
+	gc_mark_run(pm, &gray);
+	arraylist_free(&gray);
+	return NULL;
+}
+
+/* Traces everything on the gray stack using gc->mark_threads threads, including the calling one */
+static void gc_trace_parallel(Interpreter *interpreter)
+{
+	GC *gc = &interpreter->gc;
+	GCParallelMark pm = { .interpreter = interpreter, .n_markers = gc->mark_threads };
+	pthread_mutex_init(&pm.lock, NULL);
+	pthread_cond_init(&pm.cond, NULL);
+	arraylist_init(&pm.shared, sizeof(SlashObj *));
+	gc->mark_parallel = true;
+
+	pthread_t threads[GC_MARK_THREADS_MAX];
+	size_t n_threads = 0;
+	for (; n_threads < gc->mark_threads - 1; n_threads++) {
+		if (pthread_create(&threads[n_threads], NULL, gc_mark_thread, &pm) != 0)
+			break;
 	}
+	/* the calling thread is a marker as well */
+	pthread_mutex_lock(&pm.lock);
+	pm.n_markers = n_threads + 1;
+	pthread_mutex_unlock(&pm.lock);
+
+	gc_mark_run(&pm, &gc->gray_stack);
+	for (size_t i = 0; i < n_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	gc->mark_parallel = false;
+	arraylist_free(&pm.shared);
+	pthread_cond_destroy(&pm.cond);
+	pthread_mutex_destroy(&pm.lock);
+}
+
+/* Whether a stop-the-world major collection should mark in parallel */
+static bool gc_use_parallel_mark(GC *gc)
+{
+	return gc->mark_threads > 1 && gc->bytes_managing >= gc->parallel_mark_min;
 }
 
 static void gc_register(GC *gc, SlashObj *obj)
 {
-	linkedlist_append(&gc->gc_objs, obj);
+	obj->gc_next = gc->objs;
+	gc->objs = obj;
+	gc->objs_len++;
 }
 
 void gc_ctx_init(GC *gc)
 {
-	linkedlist_init(&gc->gc_objs, sizeof(SlashObj *));
+	gc->objs = NULL;
+	gc->objs_traced = NULL;
+	gc->old_objs = NULL;
+	gc->objs_len = 0;
+	gc->mark_epoch = true;
+	gc->minor = false;
+	gc->marking = false;
+	gc->sweep_link = NULL;
+	gc_pool_init(&gc->pool);
 	arraylist_init(&gc->gray_stack, sizeof(SlashObj *));
+	arraylist_init(&gc->remembered, sizeof(SlashObj *));
+	arraylist_init(&gc->new_containers, sizeof(SlashObj *));
 	arraylist_init(&gc->shadow_stack, sizeof(SlashObj **));
 
 	gc->bytes_managing = 0;
+	gc->bytes_since_run = 0;
 	gc->next_run = GC_MIN_RUN;
+	gc->minor_runs = 0;
+	gc->major_runs = 0;
+	gc->pause_total = 0;
+	gc->pause_max = 0;
+	gc->bytes_freed_minor = 0;
+	gc->bytes_freed_major = 0;
 	gc->barrier = 0;
+
+	gc->heap_grow_factor = GC_HEAP_GROW_FACTOR;
+	gc->min_run = GC_MIN_RUN;
+	gc->max_heap = 0;
+	gc->adaptive = true;
+	gc->overhead_target = GC_OVERHEAD_TARGET;
+	gc->overhead = 0;
+	gc->survival = 0;
+	gc->bytes_before_major = 0;
+	gc->cycle_start = gc_now();
+	gc->cycle_pause_start = 0;
+	gc->minor_pause_total = 0;
+	gc->cycle_minor_pause_start = 0;
+
+	gc->mark_parallel = false;
+	gc->tmp_arena = NULL;
+	gc->parallel_mark_min = GC_PARALLEL_MARK_MIN;
+	size_t n_mark_threads = GC_MARK_THREADS;
+	char *mark_threads = getenv(GC_MARK_THREADS_ENV);
+	if (mark_threads != NULL)
+		n_mark_threads = strtoul(mark_threads, NULL, 10);
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus > 0 && n_mark_threads > (size_t)cpus)
+		n_mark_threads = cpus;
+	gc_set_mark_threads(gc, n_mark_threads);
+
+	gc->mark_step = GC_MARK_STEP;
+	char *mark_step = getenv(GC_MARK_STEP_ENV);
+	if (mark_step != NULL)
+		gc->mark_step = strtoul(mark_step, NULL, 10);
 }
 
 void gc_ctx_free(GC *gc)
 {
-	linkedlist_free(&gc->gc_objs);
+	gc_pool_free(&gc->pool);
 	arraylist_free(&gc->shadow_stack);
 	arraylist_free(&gc->gray_stack);
+	arraylist_free(&gc->remembered);
+	arraylist_free(&gc->new_containers);
 }
 
-void *gc_alloc(Interpreter *interpreter, size_t size)
+/* Starts an incremental major collection. The marking is done by later calls to gc_mark_step() */
+static void gc_mark_begin(Interpreter *interpreter)
+{
+#ifdef DEBUG_LOG_GC
+	printf("-- gc incremental mark begin\n");
+#endif
+	gc_sweep_old_finish(interpreter);
+	interpreter->gc.major_runs++;
+	interpreter->gc.bytes_freed_major = 0;
+	interpreter->gc.bytes_before_major = interpreter->gc.bytes_managing;
+	interpreter->gc.marking = true;
+	gc_mark_roots(interpreter, false);
+}
+
+/* Traces at least budget values. Finishes the collection once there is nothing left to trace */
+static void gc_mark_step(Interpreter *interpreter, size_t budget)
+{
+	if (gc_trace_references(interpreter, budget))
+		gc_run_major(interpreter);
+}
+
+static void gc_add_pause(GC *gc, double start)
 {
+	double pause = gc_now() - start;
+	gc->pause_total += pause;
+	if (pause > gc->pause_max)
+		gc->pause_max = pause;
+}
+
+/* Runs a collection, or a part of one, if enough has been allocated since the previous one */
+static void gc_collect_some(Interpreter *interpreter)
+{
+	GC *gc = &interpreter->gc;
+	if (gc->sweep_link != NULL && !gc->marking)
+		gc_sweep_old(interpreter, GC_SWEEP_STEP);
 #ifdef DEBUG_STRESS_GC
-	gc_run(interpreter);
+	if (gc->marking)
+		gc_mark_step(interpreter, 1);
+	else if ((gc->minor_runs + gc->major_runs) % GC_STRESS_MAJOR_EVERY != 0)
+		gc_run_minor(interpreter);
+	else if (gc->mark_step != 0 && gc->major_runs % 2 == 0)
+		gc_mark_begin(interpreter);
+	else
+		gc_run_major(interpreter);
+	return;
 #endif
+	/* minor collections are put on hold while marking, the young generation is marked anyway */
+	if (gc->marking)
+		gc_mark_step(interpreter, gc->mark_step);
+	else if (gc->bytes_managing > gc->next_run && gc->mark_step != 0 && !gc_use_parallel_mark(gc))
+		gc_mark_begin(interpreter);
+	else if (gc->bytes_managing > gc->next_run)
+		gc_run_major(interpreter);
+	else if (gc->bytes_since_run > GC_NURSERY_SIZE)
+		gc_run_minor(interpreter);
+}
+
+static void gc_maybe_run(Interpreter *interpreter)
+{
+	GC *gc = &interpreter->gc;
+#ifndef DEBUG_STRESS_GC
+	if (!gc->marking && gc->sweep_link == NULL && gc->bytes_managing <= gc->next_run &&
+		gc->bytes_since_run <= GC_NURSERY_SIZE)
+		return;
+#endif
+	double start = gc_now();
+	gc_collect_some(interpreter);
+	gc_add_pause(gc, start);
+}
+
+/*
+ * Makes room for size more bytes under the heap limit by running a full collection.
+ * Raises a runtime error if that does not free enough.
+ */
+static void gc_reserve(Interpreter *interpreter, size_t size)
+{
+	GC *gc = &interpreter->gc;
+	if (gc->max_heap == 0 || gc->bytes_managing + size <= gc->max_heap)
+		return;
+	gc_run(interpreter);
+	if (gc->bytes_managing + size > gc->max_heap)
+		REPORT_RUNTIME_ERROR("Out of memory: heap limit of %zu bytes reached", gc->max_heap);
+}
+
+void *gc_alloc(Interpreter *interpreter, size_t size)
+{
+	if (interpreter->gc.tmp_arena != NULL)
+		return m_arena_alloc(interpreter->gc.tmp_arena, size);
+	gc_reserve(interpreter, size);
 	interpreter->gc.bytes_managing += size;
-	if (interpreter->gc.bytes_managing > interpreter->gc.next_run)
-		gc_run(interpreter);
+	interpreter->gc.bytes_since_run += size;
+	gc_maybe_run(interpreter);
 #ifdef DEBUG_LOG_GC
 	printf("gc_alloc %zu bytes\n", size);
 	printf("barrier state %d \n", interpreter->gc.barrier);
 #endif
-	return malloc(size);
+	return gc_pool_alloc(&interpreter->gc.pool, size);
 }
 
 void *gc_realloc(Interpreter *interpreter, void *p, size_t old_size, size_t new_size)
@@ -231,45 +735,75 @@ void *gc_realloc(Interpreter *interpreter, void *p, size_t old_size, size_t new_
 #ifdef DEBUG_LOG_GC
 	printf("gc_realloc diff of %zu bytes\n", new_size - old_size);
 #endif
+	assert(interpreter->gc.tmp_arena == NULL);
+	if (new_size > old_size)
+		gc_reserve(interpreter, new_size - old_size);
 	interpreter->gc.bytes_managing += new_size - old_size;
-	if (interpreter->gc.bytes_managing > interpreter->gc.next_run)
-		gc_run(interpreter);
-	return realloc(p, new_size);
+	if (new_size > old_size) {
+		interpreter->gc.bytes_since_run += new_size - old_size;
+		gc_maybe_run(interpreter);
+	}
+	return gc_pool_realloc(&interpreter->gc.pool, p, old_size, new_size);
 }
 
 void gc_free(Interpreter *interpreter, void *data, size_t size_freed)
 {
 	interpreter->gc.bytes_managing -= size_freed;
-	free(data);
+	gc_pool_dealloc(&interpreter->gc.pool, data, size_freed);
 }
 
 SlashObj *gc_new_T(Interpreter *interpreter, SlashTypeInfo *T)
+{
+	return gc_new_T_sized(interpreter, T, T->obj_size);
+}
+
+SlashObj *gc_new_T_sized(Interpreter *interpreter, SlashTypeInfo *T, size_t size)
 {
 #ifdef DEBUG_LOG_GC
 	printf("GC new %s\n", T->name);
 #endif
-	SlashObj *obj = gc_alloc(interpreter, T->obj_size);
+	assert(size >= T->obj_size);
+	SlashObj *obj = gc_alloc(interpreter, size);
+	/* new objects are traced, so they must look empty until they are initialised */
+	memset(obj, 0, T->obj_size);
 	obj->T = T;
-	obj->gc_marked = true;
+	if (interpreter->gc.tmp_arena != NULL)
+		return obj;
+	obj->gc_marked = interpreter->gc.mark_epoch;
 	obj->gc_managed = true;
 	gc_register(&interpreter->gc, obj);
+	if (gc_is_container(obj))
+		arraylist_append(&interpreter->gc.new_containers, &obj);
 	if (interpreter->gc.barrier)
 		gc_shadow_push(&interpreter->gc, obj);
 	return obj;
 }
 
-void gc_run(Interpreter *interpreter)
+void gc_run_major(Interpreter *interpreter)
 {
 #ifdef DEBUG_LOG_GC
 	size_t pre = interpreter->gc.bytes_managing;
 	printf("-- gc begin\n");
 #endif
-	gc_mark_roots(interpreter);
-	gc_trace_references(interpreter);
+	/* finish the incremental collection if one is running */
+	bool remark = interpreter->gc.marking;
+	if (!remark) {
+		gc_sweep_old_finish(interpreter);
+		interpreter->gc.major_runs++;
+		interpreter->gc.bytes_freed_major = 0;
+		interpreter->gc.bytes_before_major = interpreter->gc.bytes_managing;
+	}
+	gc_mark_roots(interpreter, remark);
+	if (gc_use_parallel_mark(&interpreter->gc))
+		gc_trace_parallel(interpreter);
+	else
+		gc_trace_references(interpreter, SIZE_MAX);
+	interpreter->gc.marking = false;
 #ifdef DEBUG_LOG_GC
 	printf("-- gc sweep\n");
 #endif
-	gc_sweep(interpreter);
+	gc_age_remembered(&interpreter->gc);
+	gc_sweep_young(interpreter);
 	gc_reset(&interpreter->gc);
 
 #ifdef DEBUG_LOG_GC
@@ -278,16 +812,109 @@ void gc_run(Interpreter *interpreter)
 #endif
 }
 
+void gc_run(Interpreter *interpreter)
+{
+	double start = gc_now();
+	gc_run_major(interpreter);
+	gc_sweep_old_finish(interpreter);
+	gc_add_pause(&interpreter->gc, start);
+}
+
+size_t gc_count_objs(Interpreter *interpreter, GCTypeCount *counts, size_t max)
+{
+	/* unreachable old objects waiting to be swept would otherwise be counted */
+	gc_sweep_old_finish(interpreter);
+	size_t n = 0;
+	SlashObj *generations[] = { interpreter->gc.objs, interpreter->gc.old_objs };
+	for (size_t i = 0; i < 2; i++) {
+		for (SlashObj *obj = generations[i]; obj != NULL; obj = obj->gc_next) {
+			size_t j = 0;
+			while (j < n && counts[j].T != obj->T)
+				j++;
+			if (j == n) {
+				if (n == max)
+					continue;
+				counts[n++] = (GCTypeCount){ .T = obj->T, .count = 0 };
+			}
+			counts[j].count++;
+		}
+	}
+	return n;
+}
+
+void gc_run_minor(Interpreter *interpreter)
+{
+#ifdef DEBUG_LOG_GC
+	size_t pre = interpreter->gc.bytes_managing;
+	printf("-- gc minor begin\n");
+#endif
+	double start = gc_now();
+	interpreter->gc.minor_runs++;
+	interpreter->gc.minor = true;
+	gc_mark_roots(interpreter, false);
+	gc_trace_references(interpreter, SIZE_MAX);
+	gc_age_remembered(&interpreter->gc);
+	gc_sweep_young(interpreter);
+	gc_reset(&interpreter->gc);
+	interpreter->gc.minor_pause_total += gc_now() - start;
+
+#ifdef DEBUG_LOG_GC
+	printf("gc freed %zu bytes\n", pre - interpreter->gc.bytes_managing);
+	printf("-- gc minor end\n");
+#endif
+}
+
+void gc_write_barrier(GC *gc, SlashObj *container, SlashValue value)
+{
+	if (!IS_OBJ(value))
+		return;
+	SlashObj *obj = AS_OBJ(value);
+	if (!obj->gc_managed)
+		return;
+	/* the container may already be traced, so the object is marked or it may never be found */
+	if (gc->marking && obj->gc_marked != gc->mark_epoch) {
+		obj->gc_marked = gc->mark_epoch;
+		arraylist_append(&gc->gray_stack, &obj);
+	}
+	if (!container->gc_old || obj->gc_old)
+		return;
+	/*
+	 * Promote the young object instead of remembering the container, so a large container is not
+	 * traced by every minor collection. The object is moved to the old generation when swept.
+	 */
+	obj->gc_old = true;
+	if (gc_is_container(obj))
+		gc_remember(gc, obj, 2);
+}
+
 void gc_collect_all(Interpreter *interpreter)
 {
 #ifdef DEBUG_LOG_GC
 	size_t pre = interpreter->gc.bytes_managing;
 	printf("-- gc collect all begin\n");
 #endif
-	for (LinkedListItem *item = interpreter->gc.gc_objs.head; item != NULL; item = item->next) {
-		SlashObj *obj = item->data;
-		gc_sweep_obj(interpreter, obj);
+#ifdef DEBUG
+	fprintf(stderr, "-- gc pool at exit\n");
+	gc_pool_report(&interpreter->gc.pool, stderr);
+#endif /* DEBUG */
+	SlashObj *generations[] = { interpreter->gc.objs, interpreter->gc.old_objs };
+	for (size_t i = 0; i < 2; i++) {
+		SlashObj *obj = generations[i];
+		while (obj != NULL) {
+			SlashObj *next = obj->gc_next;
+			gc_sweep_obj(interpreter, obj);
+			obj = next;
+		}
 	}
+	interpreter->gc.objs = NULL;
+	interpreter->gc.objs_traced = NULL;
+	interpreter->gc.old_objs = NULL;
+	interpreter->gc.objs_len = 0;
+	interpreter->gc.remembered.size = 0;
+	interpreter->gc.new_containers.size = 0;
+	interpreter->gc.gray_stack.size = 0;
+	interpreter->gc.marking = false;
+	interpreter->gc.sweep_link = NULL;
 #ifdef DEBUG_LOG_GC
 	printf("gc freed %zu bytes\n", pre - interpreter->gc.bytes_managing);
 	printf("gc bytes managing: %zu bytes\n", interpreter->gc.bytes_managing);
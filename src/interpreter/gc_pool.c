@@ -0,0 +1,225 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "interpreter/gc_pool.h"
+#include "options.h"
+
+/* let ASan catch use of freed cells even though the memory is never given back to malloc */
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/asan_interface.h>
+#define POISON(addr, size) ASAN_POISON_MEMORY_REGION((addr), (size))
+#define UNPOISON(addr, size) ASAN_UNPOISON_MEMORY_REGION((addr), (size))
+#else
+#define POISON(addr, size) ((void)(addr), (void)(size))
+#define UNPOISON(addr, size) ((void)(addr), (void)(size))
+#endif
+
+
+static const uint32_t class_sizes[GC_POOL_N_CLASSES] = {
+	16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 256, 384, 512, 768, 1024
+};
+
+/* the first cell starts after the slab header, aligned so cells can hold any type */
+#define SLAB_FIRST_CELL ((sizeof(GCSlab) + 15) & ~(size_t)15)
+#define SLAB_OF(cell) ((GCSlab *)((uintptr_t)(cell) & ~((uintptr_t)GC_POOL_SLAB_SIZE - 1)))
+
+
+static void slab_unlink(GCSlab **list, GCSlab *slab)
+{
+	if (slab->prev != NULL)
+		slab->prev->next = slab->next;
+	else
+		*list = slab->next;
+	if (slab->next != NULL)
+		slab->next->prev = slab->prev;
+}
+
+static void slab_push(GCSlab **list, GCSlab *slab)
+{
+	slab->prev = NULL;
+	slab->next = *list;
+	if (*list != NULL)
+		(*list)->prev = slab;
+	*list = slab;
+}
+
+static GCSlab *slab_new(GCPool *pool, uint8_t size_class)
+{
+	GCSlab *slab = aligned_alloc(GC_POOL_SLAB_SIZE, GC_POOL_SLAB_SIZE);
+	slab->free_cells = NULL;
+	slab->fresh = (char *)slab + SLAB_FIRST_CELL;
+	slab->used = 0;
+	slab->cells = (GC_POOL_SLAB_SIZE - SLAB_FIRST_CELL) / class_sizes[size_class];
+	slab->size_class = size_class;
+	POISON(slab->fresh, GC_POOL_SLAB_SIZE - SLAB_FIRST_CELL);
+
+	GCSizeClass *class = &pool->classes[size_class];
+	slab_push(&class->partial, slab);
+	class->slabs++;
+	return slab;
+}
+
+void gc_pool_init(GCPool *pool)
+{
+	memset(pool->classes, 0, sizeof(pool->classes));
+	uint8_t size_class = 0;
+	for (size_t i = 0; i <= GC_POOL_MAX_CELL / 16; i++) {
+		while (class_sizes[size_class] < i * 16)
+			size_class++;
+		pool->class_of[i] = size_class;
+	}
+}
+
+static void slabs_free(GCSlab *slab)
+{
+	while (slab != NULL) {
+		GCSlab *next = slab->next;
+		UNPOISON(slab, GC_POOL_SLAB_SIZE);
+		free(slab);
+		slab = next;
+	}
+}
+
+void gc_pool_free(GCPool *pool)
+{
+	for (size_t i = 0; i < GC_POOL_N_CLASSES; i++) {
+		slabs_free(pool->classes[i].partial);
+		slabs_free(pool->classes[i].full);
+	}
+	memset(pool->classes, 0, sizeof(pool->classes));
+}
+
+void *gc_pool_alloc(GCPool *pool, size_t size)
+{
+	if (size > GC_POOL_MAX_CELL)
+		return malloc(size);
+
+	uint8_t size_class = pool->class_of[(size + 15) / 16];
+	GCSizeClass *class = &pool->classes[size_class];
+	GCSlab *slab = class->partial != NULL ? class->partial : slab_new(pool, size_class);
+
+	void *cell;
+	if (slab->free_cells != NULL) {
+		cell = slab->free_cells;
+		UNPOISON(cell, sizeof(void *));
+		slab->free_cells = *(void **)cell;
+	} else {
+		cell = slab->fresh;
+		slab->fresh += class_sizes[size_class];
+	}
+	UNPOISON(cell, size);
+
+	slab->used++;
+	class->cells_used++;
+	if (slab->used == slab->cells) {
+		slab_unlink(&class->partial, slab);
+		slab_push(&class->full, slab);
+	}
+	return cell;
+}
+
+void gc_pool_dealloc(GCPool *pool, void *p, size_t size)
+{
+	if (p == NULL)
+		return;
+	if (size > GC_POOL_MAX_CELL) {
+		free(p);
+		return;
+	}
+
+	GCSlab *slab = SLAB_OF(p);
+	GCSizeClass *class = &pool->classes[slab->size_class];
+	assert(slab->size_class == pool->class_of[(size + 15) / 16]);
+	if (slab->used == slab->cells) {
+		slab_unlink(&class->full, slab);
+		slab_push(&class->partial, slab);
+	}
+	slab->used--;
+	class->cells_used--;
+
+	UNPOISON(p, sizeof(void *));
+	*(void **)p = slab->free_cells;
+	slab->free_cells = p;
+	POISON(p, class_sizes[slab->size_class]);
+}
+
+void *gc_pool_realloc(GCPool *pool, void *p, size_t old_size, size_t new_size)
+{
+	if (p == NULL)
+		return gc_pool_alloc(pool, new_size);
+	if (old_size > GC_POOL_MAX_CELL && new_size > GC_POOL_MAX_CELL)
+		return realloc(p, new_size);
+	if (old_size <= GC_POOL_MAX_CELL && new_size <= GC_POOL_MAX_CELL &&
+		pool->class_of[(old_size + 15) / 16] == pool->class_of[(new_size + 15) / 16]) {
+		UNPOISON(p, new_size);
+		return p;
+	}
+
+	void *new_p = gc_pool_alloc(pool, new_size);
+	memcpy(new_p, p, old_size < new_size ? old_size : new_size);
+	gc_pool_dealloc(pool, p, old_size);
+	return new_p;
+}
+
+void gc_pool_release_empty(GCPool *pool)
+{
+	for (size_t i = 0; i < GC_POOL_N_CLASSES; i++) {
+		GCSizeClass *class = &pool->classes[i];
+		bool kept_one = false;
+		GCSlab *slab = class->partial;
+		while (slab != NULL) {
+			GCSlab *next = slab->next;
+			if (slab->used == 0) {
+				if (kept_one) {
+					slab_unlink(&class->partial, slab);
+					class->slabs--;
+					UNPOISON(slab, GC_POOL_SLAB_SIZE);
+					free(slab);
+				}
+				kept_one = true;
+			}
+			slab = next;
+		}
+	}
+}
+
+void gc_pool_report(GCPool *pool, FILE *stream)
+{
+	size_t total_slabs = 0;
+	size_t total_used = 0;
+	fprintf(stream, "class\tslabs\tcells used\tfragmentation\n");
+	for (size_t i = 0; i < GC_POOL_N_CLASSES; i++) {
+		GCSizeClass *class = &pool->classes[i];
+		if (class->slabs == 0)
+			continue;
+		size_t used = class->cells_used * class_sizes[i];
+		size_t capacity = class->slabs * GC_POOL_SLAB_SIZE;
+		fprintf(stream, "%u\t%zu\t%zu\t\t%.1f%%\n", class_sizes[i], class->slabs, class->cells_used,
+				100.0 * (double)(capacity - used) / (double)capacity);
+		total_slabs += class->slabs;
+		total_used += used;
+	}
+	if (total_slabs != 0)
+		fprintf(stream, "total\t%zu\t%zu bytes\t%.1f%%\n", total_slabs, total_used,
+				100.0 * (double)(total_slabs * GC_POOL_SLAB_SIZE - total_used) /
+					(double)(total_slabs * GC_POOL_SLAB_SIZE));
+}
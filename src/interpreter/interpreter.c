@@ -15,6 +15,8 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <assert.h>
+#include <errno.h>
+#include <pthread.h>
 #include <setjmp.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -23,11 +25,13 @@
 
 #include "builtin/builtin.h"
 #include "interpreter/ast.h"
+#include "interpreter/compiler.h"
 #include "interpreter/error.h"
 #include "interpreter/exec.h"
 #include "interpreter/gc.h"
 #include "interpreter/interpreter.h"
 #include "interpreter/lexer.h"
+#include "interpreter/line_stream.h"
 #include "interpreter/scope.h"
 #include "interpreter/value/cast.h"
 /// #include "interpreter/value/method.h"
@@ -36,8 +40,8 @@
 #include "interpreter/value/slash_str.h"
 #include "interpreter/value/slash_value.h"
 #include "interpreter/value/type_funcs.h"
+#include "interpreter/vm.h"
 #include "lib/arena_ll.h"
-#include "lib/str_builder.h"
 #include "lib/str_view.h"
 #include "nicc/nicc.h"
 #include "sac/sac.h"
@@ -46,14 +50,15 @@
 static SlashValue eval(Interpreter *interpreter, Expr *expr);
 static void exec(Interpreter *interpreter, Stmt *stmt);
 static void exec_block(Interpreter *interpreter, BlockStmt *stmt);
+static FILE *redirect_open(Interpreter *interpreter, BinaryStmt *stmt);
 
 /*
  * helpers
  */
-static void set_exit_code(Interpreter *interpreter, int exit_code)
+void set_exit_code(Interpreter *interpreter, int exit_code)
 {
 	interpreter->prev_exit_code = exit_code;
-	SlashValue value = { .T = &num_type_info, .num = interpreter->prev_exit_code };
+	SlashValue value = NUM_VAL(interpreter->prev_exit_code);
 	var_assign(&(StrView){ .view = "?", .size = 1 }, &interpreter->globals, &value);
 }
 
@@ -77,88 +82,171 @@ static ExecResult exec_block_body(Interpreter *interpreter, BlockStmt *stmt)
 	return EXEC_NORMAL;
 }
 
-void exec_program_stub(Interpreter *interpreter, char *program_path, ArenaLL *ast_nodes)
+/*
+ * Runs the body of a loop once. Returns true if the loop is done, which is the case after a break
+ * or a return. A return is left for the enclosing function to consume.
+ */
+static bool exec_loop_body(Interpreter *interpreter, BlockStmt *body)
+{
+	ExecResult result = exec_block_body(interpreter, body);
+	if (result.type == RT_RETURN)
+		interpreter->exec_res_ctx = result;
+	return result.type == RT_BREAK || result.type == RT_RETURN;
+}
+
+static size_t cmd_argc(ArenaLL *ast_nodes)
+{
+	return ast_nodes == NULL ? 1 : ast_nodes->size + 1;
+}
+
+/*
+ * The program gets a copy of argv, so an argument converted to a str for argv can not escape the
+ * command. Str literals and conversions are therefore put on the tmp arena instead of the GC heap.
+ */
+static SlashStr *cmd_arg(Interpreter *interpreter, Expr *expr)
 {
+	if (expr->type == EXPR_STR) {
+		gc_tmp_begin(&interpreter->gc, &interpreter->tmp_arena);
+		SlashStr *arg = slash_str_new_from_view(interpreter, &((StrExpr *)expr)->view);
+		gc_tmp_end(&interpreter->gc);
+		return arg;
+	}
+	if (expr->type == EXPR_CAST &&
+		str_view_eq(((CastExpr *)expr)->type_name, (StrView){ .view = "str", .size = 3 }))
+		expr = ((CastExpr *)expr)->expr;
+
+	SlashValue value = eval(interpreter, expr);
+	VERIFY_TRAIT_IMPL(to_str, value, "Could not take 'to_str' of type '%s'", TYPE_OF(value)->name);
+	if (IS_STR(value))
+		return AS_STR(value);
+	/* to_str only allocates the str it returns */
+	gc_tmp_begin(&interpreter->gc, &interpreter->tmp_arena);
+	SlashValue value_str_repr = TYPE_OF(value)->to_str(interpreter, value);
+	gc_tmp_end(&interpreter->gc);
+	return AS_STR(value_str_repr);
+}
+
+/*
+ * Evaluates the arguments into args[1..], which must have room for cmd_argc() elements.
+ * Must be called inside a GC barrier, so the strs stay alive until they are turned into an argv.
+ */
+static void cmd_args(Interpreter *interpreter, ArenaLL *ast_nodes, SlashStr **args)
+{
+	if (ast_nodes == NULL)
+		return;
 	size_t argc = 1;
-	if (ast_nodes != NULL)
-		argc += ast_nodes->size;
-	char *argv[argc + 1]; // + 1 because last element is NULL
+	LLItem *item;
+	ARENA_LL_FOR_EACH(ast_nodes, item)
+	{
+		args[argc++] = cmd_arg(interpreter, item->value);
+	}
+}
+
+/*
+ * Turns the evaluated arguments into argv, which must have room for cmd_argc() + 1 elements.
+ * Evaluating an argument may append to a str taken earlier, so this must happen after every
+ * argument is evaluated.
+ */
+static void cmd_argv_from_args(Interpreter *interpreter, char *program_path, ArenaLL *ast_nodes,
+							   SlashStr **args, char **argv)
+{
+	size_t argc = cmd_argc(ast_nodes);
 	argv[0] = program_path;
+	for (size_t i = 1; i < argc; i++)
+		argv[i] = slash_str_cstr(interpreter, args[i]);
+	argv[argc] = NULL;
+}
 
+/*
+ * Evaluates the arguments into argv which must have room for cmd_argc() + 1 elements.
+ * The strings are only guaranteed to be valid until the next GC allocation, or until the tmp arena
+ * is released for those that are on it.
+ */
+static void cmd_argv(Interpreter *interpreter, char *program_path, ArenaLL *ast_nodes, char **argv)
+{
 	gc_barrier_start(&interpreter->gc);
-	size_t i = 1;
-	if (ast_nodes != NULL) {
-		LLItem *item;
-		ARENA_LL_FOR_EACH(ast_nodes, item)
-		{
-			SlashValue value = eval(interpreter, item->value);
-			VERIFY_TRAIT_IMPL(to_str, value, "Could not take 'to_str' of type '%s'", value.T->name);
-			SlashValue value_str_repr = value.T->to_str(interpreter, value);
-			argv[i++] = AS_STR(value_str_repr)->str;
-		}
-	}
-
-	argv[i] = NULL;
+	SlashStr *args[cmd_argc(ast_nodes)];
+	cmd_args(interpreter, ast_nodes, args);
+	cmd_argv_from_args(interpreter, program_path, ast_nodes, args, argv);
 	gc_barrier_end(&interpreter->gc);
+}
+
+void exec_program_stub(Interpreter *interpreter, char *program_path, ArenaLL *ast_nodes)
+{
+	char *argv[cmd_argc(ast_nodes) + 1]; // + 1 because last element is NULL
+	ArenaTmp tmp = m_arena_tmp_init(&interpreter->tmp_arena);
+	cmd_argv(interpreter, program_path, ast_nodes, argv);
 	int exit_code = exec_program(&interpreter->stream_ctx, argv);
+	m_arena_tmp_release(tmp);
 	set_exit_code(interpreter, exit_code);
 }
 
-static SlashValue eval_binary_operators(Interpreter *interpreter, SlashValue left, SlashValue right,
-										TokenType op)
+SlashValue eval_binary_operators(Interpreter *interpreter, SlashValue left, SlashValue right,
+								 TokenType op)
 {
 	if (IS_NONE(left) && !IS_NONE(right))
-		return (SlashValue){ .T = &bool_type_info, .boolean = false };
+		return BOOL_VAL(false);
 
 	if (!TYPE_EQ(left, right))
 		REPORT_RUNTIME_ERROR("Binary operation failed: type mismatch between '%s' and '%s'",
-							 left.T->name, right.T->name);
+							 TYPE_OF(left)->name, TYPE_OF(right)->name);
 
 	switch (op) {
 	case t_greater:
-		VERIFY_TRAIT_IMPL(cmp, left, "'>' operator not defined for type '%s'", right.T->name);
-		return (SlashValue){ .T = &bool_type_info, .boolean = left.T->cmp(left, right) > 0 };
+		VERIFY_TRAIT_IMPL(cmp, left, "'>' operator not defined for type '%s'",
+						  TYPE_OF(right)->name);
+		return BOOL_VAL(TYPE_OF(left)->cmp(left, right) > 0);
 	case t_greater_equal:
-		VERIFY_TRAIT_IMPL(cmp, left, "'>=' operator not defined for type '%s'", right.T->name);
-		return (SlashValue){ .T = &bool_type_info, .boolean = (left.T->cmp(left, right) >= 0) };
+		VERIFY_TRAIT_IMPL(cmp, left, "'>=' operator not defined for type '%s'",
+						  TYPE_OF(right)->name);
+		return BOOL_VAL((TYPE_OF(left)->cmp(left, right) >= 0));
 	case t_less:
-		VERIFY_TRAIT_IMPL(cmp, left, "'<' operator not defined for type '%s'", right.T->name);
-		return (SlashValue){ .T = &bool_type_info, .boolean = (left.T->cmp(left, right) < 0) };
+		VERIFY_TRAIT_IMPL(cmp, left, "'<' operator not defined for type '%s'",
+						  TYPE_OF(right)->name);
+		return BOOL_VAL((TYPE_OF(left)->cmp(left, right) < 0));
 	case t_less_equal:
-		VERIFY_TRAIT_IMPL(cmp, left, "'<=' operator not defined for type '%s'", right.T->name);
-		return (SlashValue){ .T = &bool_type_info, .boolean = (left.T->cmp(left, right) <= 0) };
+		VERIFY_TRAIT_IMPL(cmp, left, "'<=' operator not defined for type '%s'",
+						  TYPE_OF(right)->name);
+		return BOOL_VAL((TYPE_OF(left)->cmp(left, right) <= 0));
 	case t_plus:
 	case t_plus_equal:
-		VERIFY_TRAIT_IMPL(plus, left, "'+' operator not defined for type '%s'", right.T->name);
-		return left.T->plus(interpreter, left, right);
+		VERIFY_TRAIT_IMPL(plus, left, "'+' operator not defined for type '%s'",
+						  TYPE_OF(right)->name);
+		return TYPE_OF(left)->plus(interpreter, left, right);
 	case t_minus:
 	case t_minus_equal:
-		VERIFY_TRAIT_IMPL(minus, left, "'-' operator not defined for type '%s'", right.T->name);
-		return left.T->minus(left, right);
+		VERIFY_TRAIT_IMPL(minus, left, "'-' operator not defined for type '%s'",
+						  TYPE_OF(right)->name);
+		return TYPE_OF(left)->minus(left, right);
 	case t_slash:
 	case t_slash_equal:
-		VERIFY_TRAIT_IMPL(div, left, "'/' operator not defined for type '%s'", right.T->name);
-		return left.T->div(left, right);
+		VERIFY_TRAIT_IMPL(div, left, "'/' operator not defined for type '%s'",
+						  TYPE_OF(right)->name);
+		return TYPE_OF(left)->div(left, right);
 	case t_slash_slash:
 	case t_slash_slash_equal:
-		VERIFY_TRAIT_IMPL(int_div, left, "'//' operator not defined for type '%s'", right.T->name);
-		return left.T->int_div(left, right);
+		VERIFY_TRAIT_IMPL(int_div, left, "'//' operator not defined for type '%s'",
+						  TYPE_OF(right)->name);
+		return TYPE_OF(left)->int_div(left, right);
 	case t_percent:
 	case t_percent_equal:
-		VERIFY_TRAIT_IMPL(mod, left, "'%%' operator not defined for type '%s'", right.T->name);
-		return left.T->mod(left, right);
+		VERIFY_TRAIT_IMPL(mod, left, "'%%' operator not defined for type '%s'",
+						  TYPE_OF(right)->name);
+		return TYPE_OF(left)->mod(left, right);
 	case t_star:
 	case t_star_equal:
-		VERIFY_TRAIT_IMPL(mul, left, "'*' operator not defined for type '%s'", right.T->name);
-		return left.T->mul(interpreter, left, right);
+		VERIFY_TRAIT_IMPL(mul, left, "'*' operator not defined for type '%s'",
+						  TYPE_OF(right)->name);
+		return TYPE_OF(left)->mul(interpreter, left, right);
 	case t_star_star:
 	case t_star_star_equal:
-		VERIFY_TRAIT_IMPL(mul, left, "'**' operator not defined for type '%s'", right.T->name);
-		return left.T->pow(left, right);
+		VERIFY_TRAIT_IMPL(mul, left, "'**' operator not defined for type '%s'",
+						  TYPE_OF(right)->name);
+		return TYPE_OF(left)->pow(left, right);
 	case t_equal_equal:
-		return (SlashValue){ .T = &bool_type_info, .boolean = left.T->eq(left, right) };
+		return BOOL_VAL(TYPE_OF(left)->eq(left, right));
 	case t_bang_equal:
-		return (SlashValue){ .T = &bool_type_info, .boolean = !left.T->eq(left, right) };
+		return BOOL_VAL(!TYPE_OF(left)->eq(left, right));
 
 	default:
 		REPORT_RUNTIME_ERROR("Unrecognized binary operator");
@@ -177,11 +265,12 @@ static SlashValue eval_unary(Interpreter *interpreter, UnaryExpr *expr)
 	SlashValue right = eval(interpreter, expr->right);
 	if (expr->operator_ == t_not) {
 		VERIFY_TRAIT_IMPL(unary_not, right, "'not' operator not defined for type '%s'",
-						  right.T->name);
-		return right.T->unary_not(right);
+						  TYPE_OF(right)->name);
+		return TYPE_OF(right)->unary_not(right);
 	} else if (expr->operator_ == t_minus) {
-		VERIFY_TRAIT_IMPL(unary_minus, right, "Unary '-' not defined for type '%s'", right.T->name);
-		return right.T->unary_minus(right);
+		VERIFY_TRAIT_IMPL(unary_minus, right, "Unary '-' not defined for type '%s'",
+						  TYPE_OF(right)->name);
+		return TYPE_OF(right)->unary_minus(right);
 	}
 
 	REPORT_RUNTIME_ERROR("Internal error: Unsupported unary operator parsed correctly.");
@@ -198,18 +287,18 @@ static SlashValue eval_binary(Interpreter *interpreter, BinaryExpr *expr)
 
 	/* logical operators */
 	if (expr->operator_ == t_and) {
-		if (!left.T->truthy(left)) {
-			return_value = (SlashValue){ .T = &bool_type_info, .boolean = false };
+		if (!TYPE_OF(left)->truthy(left)) {
+			return_value = BOOL_VAL(false);
 			goto defer_gc_barrier_end;
 		}
 		right = eval(interpreter, expr->right);
-		return_value = (SlashValue){ .T = &bool_type_info, .boolean = right.T->truthy(right) };
+		return_value = BOOL_VAL(TYPE_OF(right)->truthy(right));
 		goto defer_gc_barrier_end;
 	}
 	right = eval(interpreter, expr->right);
 	if (expr->operator_ == t_or) {
-		bool truthy = left.T->truthy(left) || right.T->truthy(right);
-		return_value = (SlashValue){ .T = &bool_type_info, .boolean = truthy };
+		bool truthy = TYPE_OF(left)->truthy(left) || TYPE_OF(right)->truthy(right);
+		return_value = BOOL_VAL(truthy);
 		goto defer_gc_barrier_end;
 	}
 
@@ -217,8 +306,7 @@ static SlashValue eval_binary(Interpreter *interpreter, BinaryExpr *expr)
 	if (expr->operator_ == t_dot_dot) {
 		if (!(IS_NUM(left) && NUM_IS_INT(left) && IS_NUM(right) && NUM_IS_INT(right)))
 			REPORT_RUNTIME_ERROR("Bad range initializer");
-		SlashRange range = { .start = left.num, .end = right.num };
-		return_value = (SlashValue){ .T = &range_type_info, .range = range };
+		return_value = slash_range_new(interpreter, AS_NUM(left), AS_NUM(right));
 		goto defer_gc_barrier_end;
 	}
 
@@ -229,9 +317,10 @@ static SlashValue eval_binary(Interpreter *interpreter, BinaryExpr *expr)
 	}
 
 	/* left "IN" right */
-	VERIFY_TRAIT_IMPL(item_in, right, "'in' operator not defined for type '%s'", right.T->name);
-	bool rc = right.T->item_in(right, left);
-	return_value = (SlashValue){ .T = &bool_type_info, .boolean = rc };
+	VERIFY_TRAIT_IMPL(item_in, right, "'in' operator not defined for type '%s'",
+					  TYPE_OF(right)->name);
+	bool rc = TYPE_OF(right)->item_in(right, left);
+	return_value = BOOL_VAL(rc);
 
 
 defer_gc_barrier_end:
@@ -259,42 +348,116 @@ static SlashValue eval_subscript(Interpreter *interpreter, SubscriptExpr *expr)
 {
 	SlashValue value = eval(interpreter, expr->expr);
 	SlashValue access_index = eval(interpreter, expr->access_value);
-	VERIFY_TRAIT_IMPL(item_get, value, "'[]' operator not defined for type '%s'", value.T->name);
-	return value.T->item_get(interpreter, value, access_index);
+	VERIFY_TRAIT_IMPL(item_get, value, "'[]' operator not defined for type '%s'",
+					  TYPE_OF(value)->name);
+	return TYPE_OF(value)->item_get(interpreter, value, access_index);
+}
+
+/*
+ * The output of a subshell is read by a separate thread while the subshell statement executes,
+ * so a command never blocks on a full pipe, no matter how much it prints.
+ * The captures in flight are registered on the interpreter, so a runtime error in the statement
+ * can stop their threads and free them, see subshell_captures_abort().
+ */
+typedef struct {
+	int fd[2];
+	pthread_t reader;
+	char *buf; // malloc'ed, ownership is passed to the resulting SlashStr
+	size_t len;
+	size_t cap;
+} SubshellCapture;
+
+static void *subshell_capture_drain(void *arg)
+{
+	SubshellCapture *capture = arg;
+	while (true) {
+		/* always leave room for a full read and the null terminator */
+		if (capture->cap - capture->len < SUBSHELL_READ_SIZE + 1) {
+			capture->cap *= 2;
+			capture->buf = realloc(capture->buf, capture->cap);
+		}
+		ssize_t bytes_read = read(capture->fd[STREAM_READ_END], capture->buf + capture->len,
+								  capture->cap - capture->len - 1);
+		if (bytes_read == 0)
+			break;
+		if (bytes_read == -1) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		capture->len += bytes_read;
+	}
+	return NULL;
+}
+
+static SubshellCapture *subshell_capture_begin(Interpreter *interpreter)
+{
+	SubshellCapture *capture = malloc(sizeof(SubshellCapture));
+	*capture = (SubshellCapture){ .len = 0, .cap = SUBSHELL_READ_SIZE };
+	pipe(capture->fd);
+	capture->buf = malloc(capture->cap);
+	pthread_create(&capture->reader, NULL, subshell_capture_drain, capture);
+	arraylist_append(&interpreter->subshell_captures, &capture);
+	return capture;
+}
+
+/* Waits until everything written to the pipe is read and returns the captured bytes */
+static char *subshell_capture_end(Interpreter *interpreter, SubshellCapture *capture, size_t *len)
+{
+	close(capture->fd[STREAM_WRITE_END]);
+	pthread_join(capture->reader, NULL);
+	close(capture->fd[STREAM_READ_END]);
+	arraylist_pop(&interpreter->subshell_captures);
+
+	char *buf = capture->buf;
+	*len = capture->len;
+	free(capture);
+	return buf;
+}
+
+/*
+ * Called after a runtime error. A command started by the subshell may still hold the write end, so
+ * the readers are cancelled rather than waited on. read() is a cancellation point.
+ */
+static void subshell_captures_abort(Interpreter *interpreter)
+{
+	while (interpreter->subshell_captures.size != 0) {
+		SubshellCapture *capture;
+		arraylist_pop_and_copy(&interpreter->subshell_captures, &capture);
+		close(capture->fd[STREAM_WRITE_END]);
+		pthread_cancel(capture->reader);
+		pthread_join(capture->reader, NULL);
+		close(capture->fd[STREAM_READ_END]);
+		free(capture->buf);
+		free(capture);
+	}
 }
 
 static SlashValue eval_subshell(Interpreter *interpreter, SubshellExpr *expr)
 {
-	int fd[2];
-	pipe(fd);
+	SubshellCapture *capture = subshell_capture_begin(interpreter);
 
 	StreamCtx *stream_ctx = &interpreter->stream_ctx;
+	/* forked children should only hold on to the write end through their stdout */
+	arraylist_append(&stream_ctx->active_fds, &capture->fd[STREAM_READ_END]);
+	arraylist_append(&stream_ctx->active_fds, &capture->fd[STREAM_WRITE_END]);
+
 	int original_write_fd = stream_ctx->out_fd;
 	/* set the write fd to the newly created pipe */
-	stream_ctx->out_fd = fd[STREAM_WRITE_END];
-
+	stream_ctx->out_fd = capture->fd[STREAM_WRITE_END];
 	exec(interpreter, expr->stmt);
-	close(fd[1]);
+	/* the write end is closed below, so anything still buffered for it must be written now */
+	stream_ctx_flush(stream_ctx);
 	/* restore original write fd */
 	stream_ctx->out_fd = original_write_fd;
+	arraylist_pop(&stream_ctx->active_fds);
+	arraylist_pop(&stream_ctx->active_fds);
 
-	ArenaTmp scratch_arena = m_arena_tmp_init(&interpreter->arena);
-	size_t bytes_read = 0;
-	char buffer[4096] = { 0 };
-	StrBuilder sb;
-	str_builder_init(&sb, scratch_arena.arena);
-	while ((bytes_read = read(fd[0], buffer, 4096)) > 0)
-		str_builder_append(&sb, buffer, bytes_read);
-
-	close(fd[0]);
-
-	if (str_builder_peek(&sb) == '\n')
-		sb.len--;
-
-	StrView final = str_builder_complete(&sb);
-	SlashStr *str = (SlashStr *)gc_new_T(interpreter, &str_type_info);
-	slash_str_init_from_view(interpreter, str, &final);
-	m_arena_tmp_release(scratch_arena);
+	size_t len;
+	char *buf = subshell_capture_end(interpreter, capture, &len);
+	if (len > 0 && buf[len - 1] == '\n')
+		len--;
+	SlashStr *str = slash_str_new_from_malloced(interpreter, buf, len);
 
 	return AS_VALUE(str);
 }
@@ -313,8 +476,9 @@ static SlashValue eval_tuple(Interpreter *interpreter, SequenceExpr *expr)
 	LLItem *item;
 	ARENA_LL_FOR_EACH(&expr->seq, item)
 	{
-		SlashValue element_value = eval(interpreter, item->value);
+		SlashValue element_value = str_pool_unshare(interpreter, eval(interpreter, item->value));
 		tuple->items[i++] = element_value;
+		gc_write_barrier(&interpreter->gc, &tuple->obj, element_value);
 	}
 
 	gc_barrier_end(&interpreter->gc);
@@ -323,9 +487,8 @@ static SlashValue eval_tuple(Interpreter *interpreter, SequenceExpr *expr)
 
 static SlashValue eval_str(Interpreter *interpreter, StrExpr *expr)
 {
-	SlashStr *str = (SlashStr *)gc_new_T(interpreter, &str_type_info);
-	slash_str_init_from_view(interpreter, str, &expr->view);
-	return AS_VALUE(str);
+	StrPoolEntry *entry = str_pool_intern(&interpreter->str_pool, &expr->view);
+	return AS_VALUE(str_pool_get(interpreter, entry));
 }
 
 static SlashValue eval_list(Interpreter *interpreter, ListExpr *expr)
@@ -341,7 +504,7 @@ static SlashValue eval_list(Interpreter *interpreter, ListExpr *expr)
 	LLItem *item;
 	ARENA_LL_FOR_EACH(&expr->exprs->seq, item)
 	{
-		SlashValue element_value = eval(interpreter, item->value);
+		SlashValue element_value = str_pool_unshare(interpreter, eval(interpreter, item->value));
 		slash_list_impl_append(interpreter, list, element_value);
 	}
 
@@ -364,12 +527,13 @@ static SlashValue eval_function(Interpreter *interpreter, FunctionExpr *expr)
 		StrView *param = item->value;
 		StrView *param_cpy = scope_alloc(interpreter->scope, sizeof(StrView));
 		*param_cpy = str_view_arena_copy(interpreter->scope->arena_tmp.arena, *param);
-		arena_ll_append(&params, param);
+		arena_ll_append(&params, param_cpy);
 	}
 
 	Stmt *body_cpy = stmt_copy(interpreter->scope->arena_tmp.arena, (Stmt *)expr->body);
-	SlashFunction function = { .params = params, .body = (BlockStmt *)body_cpy };
-	return (SlashValue){ .T = &function_type_info, .function = function };
+	SlashFunction *function = scope_alloc(interpreter->scope, sizeof(SlashFunction));
+	*function = (SlashFunction){ .params = params, .body = (BlockStmt *)body_cpy, .chunk = NULL };
+	return FUNCTION_VAL(function);
 }
 
 
@@ -388,8 +552,8 @@ static SlashValue eval_map(Interpreter *interpreter, MapExpr *expr)
 	ARENA_LL_FOR_EACH(expr->key_value_pairs, item)
 	{
 		pair = item->value;
-		SlashValue k = eval(interpreter, pair->key);
-		SlashValue v = eval(interpreter, pair->value);
+		SlashValue k = str_pool_unshare(interpreter, eval(interpreter, pair->key));
+		SlashValue v = str_pool_unshare(interpreter, eval(interpreter, pair->value));
 		slash_map_impl_put(interpreter, map, k, v);
 	}
 
@@ -460,8 +624,7 @@ static SlashValue eval_cast(Interpreter *interpreter, CastExpr *expr)
 	if (hashmap_get(&interpreter->type_register, expr->type_name.view, expr->type_name.size) ==
 			&bool_type_info &&
 		expr->expr->type == EXPR_SUBSHELL)
-		return (SlashValue){ .T = &bool_type_info,
-							 .boolean = interpreter->prev_exit_code == 0 ? true : false };
+		return BOOL_VAL(interpreter->prev_exit_code == 0 ? true : false);
 
 	return dynamic_cast(interpreter, value, expr->type_name);
 }
@@ -470,32 +633,33 @@ static SlashValue eval_call(Interpreter *interpreter, CallExpr *expr)
 {
 	SlashValue callee = eval(interpreter, expr->callee);
 	if (!IS_FUNCTION(callee))
-		REPORT_RUNTIME_ERROR("Can not call value of type '%s'", callee.T->name);
+		REPORT_RUNTIME_ERROR("Can not call value of type '%s'", TYPE_OF(callee)->name);
 
-	SlashFunction function = callee.function;
+	SlashFunction *function = AS_FUNCTION(callee);
 	size_t call_params_size = expr->args == NULL ? 0 : expr->args->seq.size;
 	/* Arity check */
-	if (function.params.size != call_params_size)
+	if (function->params.size != call_params_size)
 		REPORT_RUNTIME_ERROR("Function 'FOO' takes '%zu' arguments, but '%zu' where given",
-							 function.params.size, call_params_size);
+							 function->params.size, call_params_size);
 
 	Scope *function_scope = scope_alloc(interpreter->scope, sizeof(Scope));
 	scope_init(function_scope, interpreter->scope);
 	interpreter->scope = function_scope;
 	/* Assign arguments */
-	if (function.params.size != 0) {
-		LLItem *param = function.params.head;
+	if (function->params.size != 0) {
+		LLItem *param = function->params.head;
 		LLItem *arg = expr->args->seq.head;
 		for (; param != NULL; param = param->next, arg = arg->next) {
-			SlashValue arg_value = eval(interpreter, (Expr *)arg->value);
+			SlashValue arg_value =
+				str_pool_unshare(interpreter, eval(interpreter, (Expr *)arg->value));
 			var_define(interpreter->scope, (StrView *)param->value, &arg_value);
 		}
 	}
 
 	SlashValue return_value = NoneSingleton;
-	ExecResult result = exec_block_body(interpreter, function.body);
-	if (result.type == RT_RETURN && result.return_expr != NULL)
-		return_value = eval(interpreter, result.return_expr);
+	ExecResult result = exec_block_body(interpreter, function->body);
+	if (result.type == RT_RETURN)
+		return_value = result.return_value;
 	interpreter->scope = function_scope->enclosing;
 	scope_destroy(function_scope);
 	return return_value;
@@ -511,7 +675,7 @@ static void exec_expr(Interpreter *interpreter, ExpressionStmt *stmt)
 	if (stmt->expression->type == EXPR_CALL)
 		return;
 
-	TraitPrint trait_print = value.T->print;
+	TraitPrint trait_print = TYPE_OF(value)->print;
 	VERIFY_TRAIT_IMPL(print, value, "TODO");
 	trait_print(interpreter, value);
 	///* edge case: if last char printed was a newline then we don't bother printing one */
@@ -532,7 +696,7 @@ static void exec_var(Interpreter *interpreter, VarStmt *stmt)
 		REPORT_RUNTIME_ERROR("Redefinition of '%s'", buf);
 	}
 
-	SlashValue value = eval(interpreter, stmt->initializer);
+	SlashValue value = str_pool_unshare(interpreter, eval(interpreter, stmt->initializer));
 	var_define(interpreter->scope, &stmt->name, &value);
 }
 
@@ -552,7 +716,7 @@ static void exec_seq_var(Interpreter *interpreter, SeqVarStmt *stmt)
 				str_view_to_buf_cstr(*name); // creates buf variable
 				REPORT_RUNTIME_ERROR("Redefinition of '%s'", buf);
 			}
-			SlashValue value = eval(interpreter, (Expr *)r->value);
+			SlashValue value = str_pool_unshare(interpreter, eval(interpreter, (Expr *)r->value));
 			var_define(interpreter->scope, name, &value);
 			l = l->next;
 			r = r->next;
@@ -580,30 +744,39 @@ static void exec_seq_var(Interpreter *interpreter, SeqVarStmt *stmt)
 	}
 }
 
-void exec_cmd(Interpreter *interpreter, CmdStmt *stmt)
+static WhichResult which_or_runtime_error(Interpreter *interpreter, CmdStmt *stmt)
 {
 	ScopeAndValue path =
 		var_get_or_runtime_error(interpreter->scope, &(StrView){ .view = "PATH", .size = 4 });
 	if (!IS_STR(*path.value))
 		REPORT_RUNTIME_ERROR("PATH variable should be type '%s' not '%s'", str_type_info.name,
-							 path.value->T->name);
+							 TYPE_OF(*path.value)->name);
 
-	WhichResult which_result = which(stmt->cmd_name, AS_STR(*path.value)->str);
+	char *path_cstr = slash_str_cstr(interpreter, AS_STR(*path.value));
+	WhichResult which_result = which(&interpreter->path_cache, stmt->cmd_name, path_cstr);
 	if (which_result.type == WHICH_NOT_FOUND) {
 		str_view_to_buf_cstr(stmt->cmd_name); // creates temporary buf variable
 		REPORT_RUNTIME_ERROR("Command '%s' not found", buf);
 	}
+	return which_result;
+}
 
-	if (which_result.type == WHICH_EXTERN)
+void exec_cmd(Interpreter *interpreter, CmdStmt *stmt)
+{
+	WhichResult which_result = which_or_runtime_error(interpreter, stmt);
+
+	if (which_result.type == WHICH_EXTERN) {
 		exec_program_stub(interpreter, which_result.path, stmt->arg_exprs);
-	else
+	} else {
 		which_result.builtin(interpreter, stmt->arg_exprs);
+		stream_ctx_flush(&interpreter->stream_ctx);
+	}
 }
 
 static void exec_if(Interpreter *interpreter, IfStmt *stmt)
 {
 	SlashValue r = eval(interpreter, stmt->condition);
-	if (r.T->truthy(r))
+	if (TYPE_OF(r)->truthy(r))
 		exec(interpreter, stmt->then_branch);
 	else if (stmt->else_branch != NULL)
 		exec(interpreter, stmt->else_branch);
@@ -636,26 +809,30 @@ static void exec_subscript_assign(Interpreter *interpreter, AssignStmt *stmt)
 
 	AccessExpr *access = (AccessExpr *)subscript->expr;
 	StrView var_name = access->var_name;
+	/* keeps the index and value reachable if they are copied below */
+	gc_barrier_start(&interpreter->gc);
 	SlashValue access_index = eval(interpreter, subscript->access_value);
 	SlashValue new_value = eval(interpreter, stmt->value);
 
 	ScopeAndValue current = var_get_or_runtime_error(interpreter->scope, &var_name);
 	/* the underlying self who's index (access_index) we're trying to modify */
 	SlashValue self = *current.value;
-
-	if (stmt->assignment_op == t_equal) {
-		VERIFY_TRAIT_IMPL(item_assign, self, "Item assignment not defined for type '%s'",
-						  self.T->name);
-		self.T->item_assign(interpreter, self, access_index, new_value);
-		return;
+	/* a str copies the new value into itself, anything else holds on to the key and the value */
+	if (!IS_STR(self)) {
+		access_index = str_pool_unshare(interpreter, access_index);
+		new_value = str_pool_unshare(interpreter, new_value);
 	}
 
-	// TODO: this is inefficient as we have to re-eval the access_index
-	SlashValue current_item_value = eval_subscript(interpreter, subscript);
-	new_value =
-		eval_binary_operators(interpreter, current_item_value, new_value, stmt->assignment_op);
-	VERIFY_TRAIT_IMPL(item_assign, self, "Item assignment not defined for type '%s'", self.T->name);
-	self.T->item_assign(interpreter, self, access_index, new_value);
+	if (stmt->assignment_op != t_equal) {
+		// TODO: this is inefficient as we have to re-eval the access_index
+		SlashValue current_item_value = eval_subscript(interpreter, subscript);
+		new_value =
+			eval_binary_operators(interpreter, current_item_value, new_value, stmt->assignment_op);
+	}
+	VERIFY_TRAIT_IMPL(item_assign, self, "Item assignment not defined for type '%s'",
+					  TYPE_OF(self)->name);
+	TYPE_OF(self)->item_assign(interpreter, self, access_index, new_value);
+	gc_barrier_end(&interpreter->gc);
 }
 
 static void exec_assign_unpack(Interpreter *interpreter, AssignStmt *stmt)
@@ -679,7 +856,7 @@ static void exec_assign_unpack(Interpreter *interpreter, AssignStmt *stmt)
 	ARENA_LL_FOR_EACH(&right->seq, item)
 	{
 		// TODO: can have problems with GC?
-		values[i++] = eval(interpreter, (Expr *)item->value);
+		values[i++] = str_pool_unshare(interpreter, eval(interpreter, (Expr *)item->value));
 	}
 
 	i = 0;
@@ -714,43 +891,207 @@ static void exec_assign(Interpreter *interpreter, AssignStmt *stmt)
 	SlashValue new_value = eval(interpreter, stmt->value);
 
 	if (stmt->assignment_op == t_equal) {
+		new_value = str_pool_unshare(interpreter, new_value);
 		var_assign(&var_name, variable.scope, &new_value);
 		return;
 	}
-	new_value = eval_binary_operators(interpreter, *variable.value, new_value, stmt->assignment_op);
-	var_assign(&var_name, variable.scope, &new_value);
+	/* the right operand, e.g. a returned value, may be unreachable while the operator allocates */
+	if (IS_OBJ(new_value))
+		gc_shadow_push(&interpreter->gc, AS_OBJ(new_value));
+	SlashValue result =
+		eval_binary_operators(interpreter, *variable.value, new_value, stmt->assignment_op);
+	if (IS_OBJ(new_value))
+		gc_shadow_pop(&interpreter->gc);
+	var_assign(&var_name, variable.scope, &result);
 }
 
-static void exec_pipeline(Interpreter *interpreter, PipelineStmt *stmt)
+/*
+ * Starts a pipeline stage without waiting for it. Programs are started with the argv evaluated up
+ * front, builtins are run in a fork of slash.
+ */
+static pid_t spawn_stage(Interpreter *interpreter, CmdStmt *stmt, WhichResult *which_result,
+						 char **argv, pid_t pgid, bool foreground)
 {
-	int fd[2];
-	pipe(fd);
+	if (which_result->type == WHICH_EXTERN)
+		return exec_program_async(&interpreter->stream_ctx, argv, pgid, foreground);
+
+	pid_t pid = exec_fork_in_group(&interpreter->stream_ctx, pgid, foreground);
+	if (pid != 0)
+		return pid;
+	/* a runtime error in the fork must not resume execution of the script */
+	if (setjmp(runtime_error_jmp) == RUNTIME_ERROR)
+		_exit(1);
+	int exit_code = which_result->builtin(interpreter, stmt->arg_exprs);
+	stream_ctx_flush(&interpreter->stream_ctx);
+	_exit(exit_code);
+}
 
+static void set_pipestatus(Interpreter *interpreter, int *exit_codes, size_t n)
+{
+	gc_barrier_start(&interpreter->gc);
+	SlashList *list = (SlashList *)gc_new_T(interpreter, &list_type_info);
+	slash_list_impl_init(interpreter, list);
+	for (size_t i = 0; i < n; i++)
+		slash_list_impl_append(interpreter, list, NUM_VAL(exit_codes[i]));
+	var_assign(&(StrView){ .view = "PIPESTATUS", .size = 10 }, &interpreter->globals,
+			   &AS_VALUE(list));
+	gc_barrier_end(&interpreter->gc);
+}
+
+/*
+ * Every stage of the pipeline is started before any of them are waited for, so the stages run
+ * concurrently and a stage can never block on a full pipe that nobody reads from yet.
+ * The stages share one process group which is given the terminal while the pipeline runs.
+ * Builtins are forked unless they are the last stage, in which case they run in slash itself so
+ * that e.g. `cmd | read x` assigns to x. The exit code of each stage is stored in $PIPESTATUS.
+ */
+static void exec_pipeline(Interpreter *interpreter, PipelineStmt *stmt)
+{
 	StreamCtx *stream_ctx = &interpreter->stream_ctx;
-	/* store a copy of the final write file descriptor */
-	int final_out_fd = stream_ctx->out_fd;
+	int og_in_fd = stream_ctx->in_fd;
+	int og_out_fd = stream_ctx->out_fd;
+	size_t og_active_fds = stream_ctx->active_fds.size;
+
+	size_t n_stages = 1;
+	Stmt *last = (Stmt *)stmt;
+	for (; last->type == STMT_PIPELINE; last = ((PipelineStmt *)last)->right)
+		n_stages++;
+	CmdStmt *stages[n_stages];
+	PipelineStmt *pipeline = stmt;
+	for (size_t i = 0; i < n_stages - 1; i++, pipeline = (PipelineStmt *)pipeline->right)
+		stages[i] = pipeline->left;
+	BinaryStmt *redirect = NULL;
+	if (last->type == STMT_BINARY) {
+		redirect = (BinaryStmt *)last;
+		stages[n_stages - 1] = (CmdStmt *)redirect->left;
+	} else {
+		stages[n_stages - 1] = (CmdStmt *)last;
+	}
+
+	/*
+	 * Resolve commands, evaluate the arguments of programs and open files up front so we never
+	 * leave a half started pipeline. The strs of the arguments are kept alive by the barrier until
+	 * every program is started.
+	 */
+	WhichResult which_results[n_stages];
+	for (size_t i = 0; i < n_stages; i++)
+		which_results[i] = which_or_runtime_error(interpreter, stages[i]);
+	ArenaTmp argv_tmp = m_arena_tmp_init(&interpreter->tmp_arena);
+	gc_barrier_start(&interpreter->gc);
+	SlashStr **stage_args[n_stages];
+	for (size_t i = 0; i < n_stages; i++) {
+		if (which_results[i].type != WHICH_EXTERN)
+			continue;
+		size_t argc = cmd_argc(stages[i]->arg_exprs);
+		stage_args[i] = m_arena_alloc(&interpreter->tmp_arena, sizeof(SlashStr *) * argc);
+		cmd_args(interpreter, stages[i]->arg_exprs, stage_args[i]);
+	}
+	FILE *redirect_file = NULL;
+	int last_in_fd = -1;
+	int last_out_fd = og_out_fd;
+	if (redirect != NULL) {
+		stream_ctx->in_fd = -1;
+		redirect_file = redirect_open(interpreter, redirect);
+		last_in_fd = stream_ctx->in_fd;
+		last_out_fd = stream_ctx->out_fd;
+		int redirect_fd = fileno(redirect_file);
+		arraylist_append(&stream_ctx->active_fds, &redirect_fd);
+	}
+	char **argvs[n_stages];
+	for (size_t i = 0; i < n_stages; i++) {
+		argvs[i] = NULL;
+		if (which_results[i].type != WHICH_EXTERN)
+			continue;
+		ArenaLL *arg_exprs = stages[i]->arg_exprs;
+		argvs[i] =
+			m_arena_alloc(&interpreter->tmp_arena, sizeof(char *) * (cmd_argc(arg_exprs) + 1));
+		cmd_argv_from_args(interpreter, which_results[i].path, arg_exprs, stage_args[i], argvs[i]);
+	}
 
-	stream_ctx->out_fd = fd[STREAM_WRITE_END];
-	exec_cmd(interpreter, stmt->left);
+	int pipes[n_stages - 1][2];
+	for (size_t i = 0; i < n_stages - 1; i++) {
+		pipe(pipes[i]);
+		arraylist_append(&stream_ctx->active_fds, &pipes[i][STREAM_READ_END]);
+		arraylist_append(&stream_ctx->active_fds, &pipes[i][STREAM_WRITE_END]);
+	}
 
-	/* push fie descriptors onto active_fds list/stack */
-	arraylist_append(&stream_ctx->active_fds, &fd[0]);
-	arraylist_append(&stream_ctx->active_fds, &fd[1]);
+	bool foreground = exec_owns_terminal();
+	pid_t pids[n_stages];
+	pid_t pgid = 0;
+	for (size_t i = 0; i < n_stages - 1; i++) {
+		stream_ctx->in_fd = i == 0 ? og_in_fd : pipes[i - 1][STREAM_READ_END];
+		stream_ctx->out_fd = pipes[i][STREAM_WRITE_END];
+		pids[i] =
+			spawn_stage(interpreter, stages[i], &which_results[i], argvs[i], pgid, foreground);
+		if (pgid == 0) {
+			pgid = pids[i];
+			if (foreground)
+				exec_give_terminal(pgid);
+		}
+	}
 
-	stream_ctx->out_fd = final_out_fd;
-	stream_ctx->in_fd = fd[STREAM_READ_END];
+	stream_ctx->in_fd = last_in_fd == -1 ? pipes[n_stages - 2][STREAM_READ_END] : last_in_fd;
+	stream_ctx->out_fd = last_out_fd;
 
-	exec(interpreter, stmt->right);
+	int exit_codes[n_stages];
+	WhichResult *last_which = &which_results[n_stages - 1];
+	CmdStmt *last_stage = stages[n_stages - 1];
+	bool last_in_process = last_which->type == WHICH_BUILTIN;
+	if (!last_in_process)
+		pids[n_stages - 1] = spawn_stage(interpreter, last_stage, last_which,
+										 argvs[n_stages - 1], pgid, foreground);
+	gc_barrier_end(&interpreter->gc);
+	m_arena_tmp_release(argv_tmp);
 
-	/* pop file descriptors from list/stack */
-	arraylist_pop(&stream_ctx->active_fds);
-	arraylist_pop(&stream_ctx->active_fds);
+	/* close our copies of the pipes so every reader sees EOF once its writer is done */
+	for (size_t i = 0; i < n_stages - 1; i++) {
+		close(pipes[i][STREAM_WRITE_END]);
+		if (!(last_in_process && i == n_stages - 2))
+			close(pipes[i][STREAM_READ_END]);
+	}
+	stream_ctx->active_fds.size = og_active_fds;
+
+	if (last_in_process) {
+		/* a runtime error in the builtin must not leave the stages started above behind */
+		jmp_buf og_runtime_error_jmp;
+		memcpy(og_runtime_error_jmp, runtime_error_jmp, sizeof(jmp_buf));
+		if (setjmp(runtime_error_jmp) == RUNTIME_ERROR) {
+			memcpy(runtime_error_jmp, og_runtime_error_jmp, sizeof(jmp_buf));
+			close(pipes[n_stages - 2][STREAM_READ_END]);
+			for (size_t i = 0; i < n_stages - 1; i++)
+				exec_wait(pids[i]);
+			if (foreground)
+				exec_give_terminal(getpgrp());
+			if (redirect_file != NULL)
+				fclose(redirect_file);
+			longjmp(runtime_error_jmp, RUNTIME_ERROR);
+		}
+		exit_codes[n_stages - 1] = last_which->builtin(interpreter, last_stage->arg_exprs);
+		memcpy(runtime_error_jmp, og_runtime_error_jmp, sizeof(jmp_buf));
+		stream_ctx_flush(stream_ctx);
+		close(pipes[n_stages - 2][STREAM_READ_END]);
+	}
+
+	for (size_t i = 0; i < n_stages; i++) {
+		if (i < n_stages - 1 || !last_in_process)
+			exit_codes[i] = exec_wait(pids[i]);
+	}
+	if (foreground)
+		exec_give_terminal(getpgrp());
+
+	if (redirect_file != NULL)
+		fclose(redirect_file);
+	stream_ctx->in_fd = og_in_fd;
+	stream_ctx->out_fd = og_out_fd;
+
+	set_exit_code(interpreter, exit_codes[n_stages - 1]);
+	set_pipestatus(interpreter, exit_codes, n_stages);
 }
 
 static void exec_assert(Interpreter *interpreter, AssertStmt *stmt)
 {
 	SlashValue result = eval(interpreter, stmt->expr);
-	TraitTruthy truthy_func = result.T->truthy;
+	TraitTruthy truthy_func = TYPE_OF(result)->truthy;
 	if (!truthy_func(result))
 		REPORT_RUNTIME_ERROR("Assertion failed");
 }
@@ -762,19 +1103,17 @@ static void exec_loop(Interpreter *interpreter, LoopStmt *stmt)
 	interpreter->scope = block_scope;
 
 	SlashValue r = eval(interpreter, stmt->condition);
-	TraitTruthy truthy_func = r.T->truthy;
+	TraitTruthy truthy_func = TYPE_OF(r)->truthy;
 	while (truthy_func(r)) {
-		ExecResultType result_t = exec_block_body(interpreter, stmt->body_block).type;
-		if (result_t == RT_BREAK)
+		if (exec_loop_body(interpreter, stmt->body_block))
 			break;
-		if (result_t == RT_CONTINUE) {
-			scope_reset(block_scope);
-			continue;
-		}
+		/* the condition is evaluated again after a continue as well */
 		r = eval(interpreter, stmt->condition);
 		scope_reset(block_scope);
 	}
 
+	interpreter->scope = block_scope->enclosing;
+	interpreter->scope->arena_tmp.arena->offset -= sizeof(Scope);
 	scope_destroy(block_scope);
 }
 
@@ -787,9 +1126,9 @@ static void exec_iter_loop_list(Interpreter *interpreter, IterLoopStmt *stmt, Sl
 	for (size_t i = 0; i < iterable->len; i++) {
 		iterator_value = slash_list_impl_get(iterable, i);
 		var_assign(&stmt->var_name, interpreter->scope, &iterator_value);
-		ExecResultType result_t = exec_block_body(interpreter, stmt->body_block).type;
+		bool done = exec_loop_body(interpreter, stmt->body_block);
 		scope_reset(interpreter->scope);
-		if (result_t == RT_BREAK)
+		if (done)
 			break;
 	}
 }
@@ -803,9 +1142,9 @@ static void exec_iter_loop_tuple(Interpreter *interpreter, IterLoopStmt *stmt, S
 	for (size_t i = 0; i < iterable->len; i++) {
 		iterator_value = &iterable->items[i];
 		var_assign(&stmt->var_name, interpreter->scope, iterator_value);
-		ExecResultType result_t = exec_block_body(interpreter, stmt->body_block).type;
+		bool done = exec_loop_body(interpreter, stmt->body_block);
 		scope_reset(interpreter->scope);
-		if (result_t == RT_BREAK)
+		if (done)
 			break;
 	}
 }
@@ -824,9 +1163,9 @@ static void exec_iter_loop_map(Interpreter *interpreter, IterLoopStmt *stmt, Sla
 	for (size_t i = 0; i < iterable->len; i++) {
 		iterator_value = &keys[i];
 		var_assign(&stmt->var_name, interpreter->scope, iterator_value);
-		ExecResultType result_t = exec_block_body(interpreter, stmt->body_block).type;
+		bool done = exec_loop_body(interpreter, stmt->body_block);
 		scope_reset(interpreter->scope);
-		if (result_t == RT_BREAK)
+		if (done)
 			break;
 	}
 }
@@ -836,46 +1175,75 @@ static void exec_iter_loop_str(Interpreter *interpreter, IterLoopStmt *stmt, Sla
 	ScopeAndValue ifs_res =
 		var_get_or_runtime_error(interpreter->scope, &(StrView){ .view = "IFS", .size = 3 });
 	if (!IS_STR(*ifs_res.value))
-		REPORT_RUNTIME_ERROR("$IFS has to be of type 'str', but got '%s'", ifs_res.value->T->name);
+		REPORT_RUNTIME_ERROR("$IFS has to be of type 'str', but got '%s'",
+							 TYPE_OF(*ifs_res.value)->name);
 
 	SlashStr *ifs = AS_STR(*ifs_res.value);
-	SlashList *substrings = slash_str_split(interpreter, iterable, ifs->str, true);
+	SlashList *substrings =
+		slash_str_split(interpreter, iterable, slash_str_cstr(interpreter, ifs), true);
 	gc_shadow_push(&interpreter->gc, &substrings->obj);
 	exec_iter_loop_list(interpreter, stmt, substrings);
 	gc_shadow_pop(&interpreter->gc);
 }
 
-static void exec_iter_loop_range(Interpreter *interpreter, IterLoopStmt *stmt, SlashRange iterable)
+static void exec_iter_loop_range(Interpreter *interpreter, IterLoopStmt *stmt, SlashRange *iterable)
 {
-	if (iterable.start >= iterable.end)
+	if (iterable->start >= iterable->end)
 		return;
 
-	SlashValue iterator_value = { .T = &num_type_info, .num = iterable.start };
+	SlashValue iterator_value = NUM_VAL(iterable->start);
 	/* define the loop variable that holds the current iterator value */
 	var_define(interpreter->scope, &stmt->var_name, &iterator_value);
 
-	while (iterator_value.num != iterable.end) {
-		ExecResultType result_t = exec_block_body(interpreter, stmt->body_block).type;
+	while (AS_NUM(iterator_value) != iterable->end) {
+		bool done = exec_loop_body(interpreter, stmt->body_block);
 		scope_reset(interpreter->scope);
-		iterator_value.num++;
+		iterator_value = NUM_VAL(AS_NUM(iterator_value) + 1);
+		var_assign(&stmt->var_name, interpreter->scope, &iterator_value);
+		if (done)
+			break;
+	}
+}
+
+static void exec_iter_loop_line_stream(Interpreter *interpreter, IterLoopStmt *stmt,
+									   SlashLineStream *iterable)
+{
+	/* define the loop variable that holds the current iterator value */
+	var_define(interpreter->scope, &stmt->var_name, NULL);
+
+	SlashValue iterator_value;
+	while (line_stream_next(interpreter, iterable, &iterator_value)) {
 		var_assign(&stmt->var_name, interpreter->scope, &iterator_value);
-		if (result_t == RT_BREAK)
+		bool done = exec_loop_body(interpreter, stmt->body_block);
+		scope_reset(interpreter->scope);
+		if (done)
 			break;
 	}
+	line_stream_close(interpreter, iterable);
 }
 
 static void exec_iter_loop(Interpreter *interpreter, IterLoopStmt *stmt)
 {
+	/*
+	 * Iterate over the output of a subshell while it runs instead of capturing it first.
+	 * Evaluated outside the loop scope so a builtin in the subshell defines in the enclosing scope.
+	 */
+	SlashValue underlying;
+	if (stmt->underlying_iterable->type == EXPR_SUBSHELL)
+		underlying = line_stream_or_capture(interpreter, (SubshellExpr *)stmt->underlying_iterable);
+	else
+		underlying = eval(interpreter, stmt->underlying_iterable);
+	if (IS_OBJ(underlying))
+		gc_shadow_push(&interpreter->gc, AS_OBJ(underlying));
+
 	Scope loop_scope;
 	scope_init(&loop_scope, interpreter->scope);
 	interpreter->scope = &loop_scope;
 
-	SlashValue underlying = eval(interpreter, stmt->underlying_iterable);
-	if (IS_OBJ(underlying))
-		gc_shadow_push(&interpreter->gc, underlying.obj);
-
-	if (IS_RANGE(underlying))
-		exec_iter_loop_range(interpreter, stmt, underlying.range);
+	if (IS_LINE_STREAM(underlying))
+		exec_iter_loop_line_stream(interpreter, stmt, AS_LINE_STREAM(underlying));
+	else if (IS_RANGE(underlying))
+		exec_iter_loop_range(interpreter, stmt, AS_RANGE(underlying));
 	else if (IS_LIST(underlying))
 		exec_iter_loop_list(interpreter, stmt, AS_LIST(underlying));
 	else if (IS_TUPLE(underlying))
@@ -885,7 +1253,7 @@ static void exec_iter_loop(Interpreter *interpreter, IterLoopStmt *stmt)
 	else if (IS_STR(underlying))
 		exec_iter_loop_str(interpreter, stmt, AS_STR(underlying));
 	else
-		REPORT_RUNTIME_ERROR("Type '%s' can not be iterated over", underlying.T->name);
+		REPORT_RUNTIME_ERROR("Type '%s' can not be iterated over", TYPE_OF(underlying)->name);
 
 	if (IS_OBJ(underlying))
 		gc_shadow_pop(&interpreter->gc);
@@ -904,10 +1272,10 @@ static void exec_andor(Interpreter *interpreter, BinaryStmt *stmt)
 	if (stmt->left->type == STMT_EXPRESSION) {
 		ExpressionStmt *left = (ExpressionStmt *)stmt->left;
 		SlashValue value = eval(interpreter, left->expression);
-		TraitTruthy truthy_func = value.T->truthy;
+		TraitTruthy truthy_func = TYPE_OF(value)->truthy;
 		if (truthy_func == NULL)
 			REPORT_RUNTIME_ERROR("&& or || failed becuase truthy is not defined for type '%s'",
-								 value.T->name);
+								 TYPE_OF(value)->name);
 		predicate = truthy_func(value);
 	} else {
 		exec(interpreter, stmt->left);
@@ -919,20 +1287,19 @@ static void exec_andor(Interpreter *interpreter, BinaryStmt *stmt)
 		exec(interpreter, stmt->right_stmt);
 }
 
-static void exec_redirect(Interpreter *interpreter, BinaryStmt *stmt)
+/* Opens the file of the redirection and points the in or out fd of the StreamCtx to it */
+static FILE *redirect_open(Interpreter *interpreter, BinaryStmt *stmt)
 {
 	// TODO: here we assume the cmd_stmt can NOT mutate the stmt->right_expr, however, this may
 	//       not always be guaranteed ?.
 	SlashValue value = eval(interpreter, stmt->right_expr);
-	TraitToStr to_str = value.T->to_str;
+	TraitToStr to_str = TYPE_OF(value)->to_str;
 	if (to_str == NULL)
 		REPORT_RUNTIME_ERROR("Redirection failed because to_str is not defined for type '%s'",
-							 value.T->name);
+							 TYPE_OF(value)->name);
 
-	char *file_name = AS_STR(to_str(interpreter, value))->str;
+	char *file_name = slash_str_cstr(interpreter, AS_STR(to_str(interpreter, value)));
 	StreamCtx *stream_ctx = &interpreter->stream_ctx;
-	int og_read = stream_ctx->in_fd;
-	int og_write = stream_ctx->out_fd;
 
 	bool new_write_fd = true;
 	FILE *file = NULL;
@@ -955,7 +1322,18 @@ static void exec_redirect(Interpreter *interpreter, BinaryStmt *stmt)
 		stream_ctx->out_fd = fileno(file);
 	else
 		stream_ctx->in_fd = fileno(file);
+	return file;
+}
+
+static void exec_redirect(Interpreter *interpreter, BinaryStmt *stmt)
+{
+	StreamCtx *stream_ctx = &interpreter->stream_ctx;
+	int og_read = stream_ctx->in_fd;
+	int og_write = stream_ctx->out_fd;
+
+	FILE *file = redirect_open(interpreter, stmt);
 	exec_cmd(interpreter, (CmdStmt *)stmt->left);
+	stream_ctx_flush(stream_ctx);
 	fclose(file);
 	stream_ctx->in_fd = og_read;
 	stream_ctx->out_fd = og_write;
@@ -976,7 +1354,9 @@ static void exec_abrupt_control_flow(Interpreter *interpreter, AbruptControlFlow
 		result.type = RT_CONTINUE;
 	} else if (stmt->ctrlf_type == t_return) {
 		result.type = RT_RETURN;
-		result.return_expr = stmt->return_expr;
+		/* leaving the scopes up to the function does not allocate, so the value stays alive */
+		result.return_value =
+			stmt->return_expr == NULL ? NoneSingleton : eval(interpreter, stmt->return_expr);
 	}
 	interpreter->exec_res_ctx = result;
 }
@@ -1030,7 +1410,7 @@ static SlashValue eval(Interpreter *interpreter, Expr *expr)
 	default:
 		REPORT_RUNTIME_ERROR("Internal error: expression type not recognized");
 		/* will never happen, but lets make the compiler happy */
-		return (SlashValue){ 0 };
+		return NoneSingleton;
 	}
 }
 
@@ -1081,15 +1461,28 @@ static void exec(Interpreter *interpreter, Stmt *stmt)
 	}
 }
 
+SlashValue tree_walk_eval(Interpreter *interpreter, Expr *expr)
+{
+	return eval(interpreter, expr);
+}
+
+void tree_walk_exec(Interpreter *interpreter, Stmt *stmt)
+{
+	exec(interpreter, stmt);
+}
+
 void interpreter_init(Interpreter *interpreter, int argc, char **argv)
 {
 	m_arena_init_dynamic(&interpreter->arena, 1, 16384);
+	m_arena_init_dynamic(&interpreter->tmp_arena, 1, 16384);
 
 	scope_init_globals(&interpreter->globals, &interpreter->arena, argc, argv);
 	interpreter->scope = &interpreter->globals;
 
 	gc_ctx_init(&interpreter->gc);
 
+	str_pool_init(&interpreter->str_pool);
+	arraylist_init(&interpreter->subshell_captures, sizeof(SubshellCapture *));
 	hashmap_init(&interpreter->type_register);
 	/* Populate type register with all the builtin types types found in Slash */
 	hashmap_put(&interpreter->type_register, "bool", sizeof("bool") - 1, &bool_type_info,
@@ -1124,29 +1517,63 @@ void interpreter_init(Interpreter *interpreter, int argc, char **argv)
 	/* Init default StreamCtx */
 	StreamCtx stream_ctx = { .in_fd = STDIN_FILENO,
 							 .out_fd = STDOUT_FILENO,
-							 .err_fd = STDERR_FILENO };
+							 .err_fd = STDERR_FILENO,
+							 .buf_fd = STDOUT_FILENO,
+							 .buf_len = 0 };
 	arraylist_init(&stream_ctx.active_fds, sizeof(int));
 	interpreter->stream_ctx = stream_ctx;
+	runtime_error_stream_ctx = &interpreter->stream_ctx;
 
 	interpreter->exec_res_ctx = EXEC_NORMAL;
 	interpreter->source_line = -1;
+
+	vm_init(&interpreter->vm);
+	path_cache_init(&interpreter->path_cache);
+
+	/* Define '$PIPESTATUS' that holds the exit code of each stage of the previous pipeline */
+	SlashList *pipestatus = (SlashList *)gc_new_T(interpreter, &list_type_info);
+	slash_list_impl_init(interpreter, pipestatus);
+	var_define(&interpreter->globals, &(StrView){ .view = "PIPESTATUS", .size = 10 },
+			   &AS_VALUE(pipestatus));
 }
 
 void interpreter_free(Interpreter *interpreter)
 {
+	gc_stats_report_at_exit(interpreter);
 	gc_collect_all(interpreter);
+	vm_free(&interpreter->vm);
 	gc_ctx_free(&interpreter->gc);
 	scope_destroy(&interpreter->globals);
 	hashmap_free(&interpreter->type_register);
+	str_pool_free(&interpreter->str_pool);
+	arraylist_free(&interpreter->subshell_captures);
 	arraylist_free(&interpreter->stream_ctx.active_fds);
+	runtime_error_stream_ctx = NULL;
+	path_cache_free(&interpreter->path_cache);
+	m_arena_release(&interpreter->tmp_arena);
 }
 
 static void interpreter_reset_from_err(Interpreter *interpreter)
 {
+	/*
+	 * Values on the VM stack and the shadow stack belong to what we just left. The loops over line
+	 * streams among them stop their subshells, as leaving the loops in any other way would.
+	 */
+	for (size_t i = 0; i < interpreter->gc.shadow_stack.size; i++) {
+		SlashObj *obj = *(SlashObj **)arraylist_get(&interpreter->gc.shadow_stack, i);
+		if (obj->T == &line_stream_type_info)
+			line_stream_close(interpreter, (SlashLineStream *)obj);
+	}
+	vm_unwind(interpreter, interpreter->vm.stack);
+
 	/* Pop everything from shadow stack as they are no longer in use */
 	interpreter->gc.shadow_stack.size = 0;
 	interpreter->gc.barrier = 0;
 
+	/* Temporaries belong to the expressions or commands we just left */
+	gc_tmp_end(&interpreter->gc);
+	m_arena_clear(&interpreter->tmp_arena);
+
 	/* Free any old scopes */
 	while (interpreter->scope != &interpreter->globals) {
 		Scope *to_destroy = interpreter->scope;
@@ -1154,11 +1581,15 @@ static void interpreter_reset_from_err(Interpreter *interpreter)
 		scope_destroy(to_destroy);
 	}
 
-	/* Reset stream_ctx */
+	/* Reset stream_ctx. Flushed first as the output may belong to a subshell being captured */
+	stream_ctx_flush(&interpreter->stream_ctx);
+	subshell_captures_abort(interpreter);
 	arraylist_free(&interpreter->stream_ctx.active_fds);
 	StreamCtx stream_ctx = { .in_fd = STDIN_FILENO,
 							 .out_fd = STDOUT_FILENO,
-							 .err_fd = STDERR_FILENO };
+							 .err_fd = STDERR_FILENO,
+							 .buf_fd = STDOUT_FILENO,
+							 .buf_len = 0 };
 	arraylist_init(&stream_ctx.active_fds, sizeof(int));
 	interpreter->stream_ctx = stream_ctx;
 
@@ -1168,21 +1599,40 @@ static void interpreter_reset_from_err(Interpreter *interpreter)
 
 int interpreter_run(Interpreter *interpreter, ArrayList *statements)
 {
+	Chunk chunk;
+	if (!interpreter->tree_walk) {
+		compile_program(&chunk, &interpreter->str_pool, &interpreter->globals, statements);
+#ifdef DEBUG
+		chunk_disassemble(&chunk);
+#endif /* DEBUG */
+	}
+
 	if (setjmp(runtime_error_jmp) != RUNTIME_ERROR) {
-		for (size_t i = 0; i < statements->size; i++)
-			exec(interpreter, *(Stmt **)arraylist_get(statements, i));
+		if (interpreter->tree_walk) {
+			for (size_t i = 0; i < statements->size; i++)
+				exec(interpreter, *(Stmt **)arraylist_get(statements, i));
+		} else {
+			vm_run(interpreter, &chunk);
+		}
 	} else {
 		/* execution enters here on a runtime error, therefore we must "reset" the interpreter */
 		interpreter_reset_from_err(interpreter);
 		set_exit_code(interpreter, 1);
 	}
+
+	stream_ctx_flush(&interpreter->stream_ctx);
+	if (!interpreter->tree_walk)
+		chunk_free(&chunk);
 	return interpreter->prev_exit_code;
 }
 
-int interpret(ArrayList *statements, int argc, char **argv)
+int interpret(ArrayList *statements, int argc, char **argv, bool tree_walk, size_t max_heap)
 {
 	Interpreter interpreter = { 0 };
 	interpreter_init(&interpreter, argc, argv);
+	interpreter.tree_walk = tree_walk;
+	interpreter.gc.max_heap = max_heap;
+	gc_set_next_run(&interpreter.gc);
 	interpreter_run(&interpreter, statements);
 	interpreter_free(&interpreter);
 	return interpreter.prev_exit_code;
@@ -0,0 +1,239 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "builtin/builtin.h"
+#include "interpreter/error.h"
+#include "interpreter/gc.h"
+#include "interpreter/interpreter.h"
+#include "interpreter/line_stream.h"
+#include "interpreter/scope.h"
+#include "interpreter/value/slash_str.h"
+#include "interpreter/value/slash_value.h"
+#include "options.h"
+
+
+static void line_stream_print(Interpreter *interpreter, SlashValue self)
+{
+	assert(IS_LINE_STREAM(self));
+	SLASH_PRINT(&interpreter->stream_ctx, "<line stream %d>", AS_LINE_STREAM(self)->pid);
+}
+
+static bool line_stream_truthy(SlashValue self)
+{
+	(void)self;
+	return true;
+}
+
+static bool line_stream_eq(SlashValue self, SlashValue other)
+{
+	return AS_OBJ(self) == AS_OBJ(other);
+}
+
+SlashTypeInfo line_stream_type_info = { .name = "line_stream",
+										.plus = NULL,
+										.minus = NULL,
+										.mul = NULL,
+										.div = NULL,
+										.int_div = NULL,
+										.pow = NULL,
+										.mod = NULL,
+										.unary_minus = NULL,
+										.unary_not = NULL,
+										.print = line_stream_print,
+										.to_str = NULL,
+										.item_get = NULL,
+										.item_assign = NULL,
+										.item_in = NULL,
+										.truthy = line_stream_truthy,
+										.eq = line_stream_eq,
+										.cmp = NULL,
+										.hash = NULL,
+										.obj_size = sizeof(SlashLineStream) };
+
+
+/* The last command of a pipeline that is a builtin runs in slash itself, see exec_pipeline() */
+static bool subshell_ends_in_builtin(Interpreter *interpreter, SubshellExpr *expr)
+{
+	Stmt *last = expr->stmt;
+	while (last->type == STMT_PIPELINE)
+		last = ((PipelineStmt *)last)->right;
+	if (last->type == STMT_BINARY)
+		last = ((BinaryStmt *)last)->left;
+	if (last->type != STMT_CMD)
+		return false;
+
+	ScopeAndValue path = var_get(interpreter->scope, &(StrView){ .view = "PATH", .size = 4 });
+	char *PATH = path.value != NULL && IS_STR(*path.value) ?
+					 slash_str_cstr(interpreter, AS_STR(*path.value)) :
+					 "";
+	return which(&interpreter->path_cache, ((CmdStmt *)last)->cmd_name, PATH).type ==
+		   WHICH_BUILTIN;
+}
+
+SlashValue line_stream_or_capture(Interpreter *interpreter, SubshellExpr *expr)
+{
+	if (subshell_ends_in_builtin(interpreter, expr))
+		return tree_walk_eval(interpreter, (Expr *)expr);
+	return AS_VALUE(line_stream_new(interpreter, expr));
+}
+
+SlashLineStream *line_stream_new(Interpreter *interpreter, SubshellExpr *expr)
+{
+	ScopeAndValue ifs_res =
+		var_get_or_runtime_error(interpreter->scope, &(StrView){ .view = "IFS", .size = 3 });
+	if (!IS_STR(*ifs_res.value))
+		REPORT_RUNTIME_ERROR("$IFS has to be of type 'str', but got '%s'",
+							 TYPE_OF(*ifs_res.value)->name);
+
+	int fd[2];
+	pipe(fd);
+	/* the child would otherwise write the buffered output a second time */
+	stream_ctx_flush(&interpreter->stream_ctx);
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(fd[STREAM_READ_END]);
+		interpreter->stream_ctx.out_fd = fd[STREAM_WRITE_END];
+		/* a runtime error in the fork must not resume execution of the script */
+		if (setjmp(runtime_error_jmp) == RUNTIME_ERROR)
+			_exit(1);
+		tree_walk_exec(interpreter, expr->stmt);
+		stream_ctx_flush(&interpreter->stream_ctx);
+		_exit(interpreter->prev_exit_code);
+	}
+	close(fd[STREAM_WRITE_END]);
+	/* not in active_fds as streams outlive the commands that open them, so close it on exec */
+	fcntl(fd[STREAM_READ_END], F_SETFD, FD_CLOEXEC);
+
+	SlashLineStream *stream = (SlashLineStream *)gc_new_T(interpreter, &line_stream_type_info);
+	stream->pid = pid;
+	stream->fd = fd[STREAM_READ_END];
+	stream->eof = false;
+	stream->start = 0;
+	stream->len = 0;
+	stream->cap = SUBSHELL_READ_SIZE;
+	stream->buf = malloc(stream->cap);
+	stream->separators = strdup(slash_str_cstr(interpreter, AS_STR(*ifs_res.value)));
+	return stream;
+}
+
+/* Reads at least one more byte into the buffer, or sets eof */
+static void line_stream_fill(SlashLineStream *stream)
+{
+	/* drop the items that have been handed out */
+	if (stream->start != 0) {
+		memmove(stream->buf, stream->buf + stream->start, stream->len - stream->start);
+		stream->len -= stream->start;
+		stream->start = 0;
+	}
+	if (stream->cap - stream->len < SUBSHELL_READ_SIZE) {
+		stream->cap *= 2;
+		stream->buf = realloc(stream->buf, stream->cap);
+	}
+
+	ssize_t bytes_read;
+	do {
+		bytes_read = read(stream->fd, stream->buf + stream->len, stream->cap - stream->len);
+	} while (bytes_read == -1 && errno == EINTR);
+	if (bytes_read <= 0)
+		stream->eof = true;
+	else
+		stream->len += bytes_read;
+}
+
+static SlashValue line_stream_item(Interpreter *interpreter, SlashLineStream *stream, size_t end)
+{
+	SlashStr *str =
+		slash_str_new_from_slice(interpreter, stream->buf + stream->start, end - stream->start);
+	return AS_VALUE(str);
+}
+
+bool line_stream_next(Interpreter *interpreter, SlashLineStream *stream, SlashValue *next)
+{
+	if (stream->fd == -1)
+		return false;
+
+	size_t separators_len = strlen(stream->separators);
+	size_t scan = 0; // relative to start as filling the buffer may move the items
+	while (true) {
+		for (; stream->start + scan < stream->len; scan++) {
+			size_t end = stream->start + scan;
+			if (memchr(stream->separators, stream->buf[end], separators_len) == NULL)
+				continue;
+			/*
+			 * Captured output has its trailing newline removed, so a newline that ends the
+			 * output does not separate an empty item. Can only be known once more is read.
+			 */
+			if (scan == 0 && stream->buf[end] == '\n' && end + 1 == stream->len) {
+				if (!stream->eof)
+					break;
+				stream->start = stream->len;
+				continue;
+			}
+			*next = line_stream_item(interpreter, stream, end);
+			stream->start = end + 1;
+			return true;
+		}
+
+		if (stream->eof) {
+			size_t end = stream->len;
+			if (end > stream->start && stream->buf[end - 1] == '\n')
+				end--;
+			if (end == stream->start) {
+				line_stream_close(interpreter, stream);
+				return false;
+			}
+			*next = line_stream_item(interpreter, stream, end);
+			stream->start = stream->len;
+			return true;
+		}
+		line_stream_fill(stream);
+	}
+}
+
+void line_stream_close(Interpreter *interpreter, SlashLineStream *stream)
+{
+	if (stream->fd != -1) {
+		close(stream->fd);
+		stream->fd = -1;
+	}
+	if (stream->pid != -1) {
+		int status;
+		waitpid(stream->pid, &status, 0);
+		stream->pid = -1;
+		set_exit_code(interpreter,
+					  WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+	}
+}
+
+void line_stream_free(Interpreter *interpreter, SlashLineStream *stream)
+{
+	(void)interpreter;
+	if (stream->fd != -1)
+		close(stream->fd);
+	/* the subshell gets SIGPIPE if it is still writing, reap it so it does not become a zombie */
+	if (stream->pid != -1)
+		waitpid(stream->pid, NULL, 0);
+	free(stream->buf);
+	free(stream->separators);
+}
@@ -665,7 +665,7 @@ static Expr *single(Parser *parser)
 		/* insert num literal '0' when we encounter a range initializer in this form : '..expr' */
 		LiteralExpr *expr =
 			(LiteralExpr *)expr_alloc(parser->ast_arena, EXPR_LITERAL, parser->source_line);
-		expr->value = (SlashValue){ .T = &num_type_info, .num = 0 };
+		expr->value = NUM_VAL(0);
 		left = (Expr *)expr;
 	} else {
 		/* continue the "normal" recursive path */
@@ -801,7 +801,9 @@ static Expr *primary(Parser *parser)
 	if (token->type == t_dt_text_lit) {
 		LiteralExpr *expr =
 			(LiteralExpr *)expr_alloc(parser->ast_arena, EXPR_LITERAL, parser->source_line);
-		expr->value = (SlashValue){ .T = &text_lit_type_info, .text_lit = token->lexeme };
+		StrView *lexeme = m_arena_alloc_struct(parser->ast_arena, StrView);
+		*lexeme = token->lexeme;
+		expr->value = TEXT_LIT_VAL(lexeme);
 		return (Expr *)expr;
 	}
 
@@ -817,7 +819,7 @@ static Expr *bool_lit(Parser *parser)
 	LiteralExpr *expr =
 		(LiteralExpr *)expr_alloc(parser->ast_arena, EXPR_LITERAL, parser->source_line);
 	expr->value =
-		(SlashValue){ .T = &bool_type_info, .boolean = token->type == t_true ? true : false };
+		BOOL_VAL(token->type == t_true ? true : false);
 	return (Expr *)expr;
 }
 
@@ -826,7 +828,7 @@ static Expr *number(Parser *parser)
 	Token *token = previous(parser);
 	LiteralExpr *expr =
 		(LiteralExpr *)expr_alloc(parser->ast_arena, EXPR_LITERAL, parser->source_line);
-	expr->value = (SlashValue){ .T = &num_type_info, .num = str_view_to_double(token->lexeme) };
+	expr->value = NUM_VAL(str_view_to_double(token->lexeme));
 	return (Expr *)expr;
 }
 
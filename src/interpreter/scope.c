@@ -17,6 +17,9 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
 
 #include "interpreter/scope.h"
 #include "interpreter/value/slash_str.h"
@@ -27,6 +30,8 @@
 
 extern char **environ;
 
+#define SCOPE_MIN_CAP 8
+
 
 static int get_char_pos(char *str, char m)
 {
@@ -77,7 +82,7 @@ static void set_globals(Scope *scope)
 #endif /* DEBUG*/
 
 	/* Define '$?' that holds the value of the previous exit code */
-	SlashValue exit_code_value = { .T = &num_type_info, .num = 0 };
+	SlashValue exit_code_value = NUM_VAL(0);
 	var_define(scope, &(StrView){ .view = "?", .size = 1 }, &exit_code_value);
 }
 
@@ -91,33 +96,106 @@ static void scope_init_argv(Scope *scope, int argc, char **argv)
 	}
 }
 
+ssize_t scope_find_slot(Scope *scope, StrView *key)
+{
+	if (scope->index != NULL) {
+		size_t *slot = hashmap_get(scope->index, key->view, (uint32_t)key->size);
+		return slot == NULL ? -1 : (ssize_t)*slot;
+	}
+
+	for (size_t i = 0; i < scope->len; i++) {
+		StrView *name = &scope->names[i];
+		if (name->size == key->size && memcmp(name->view, key->view, key->size) == 0)
+			return i;
+	}
+	return -1;
+}
+
+static size_t scope_append_slot(Scope *scope, StrView *key)
+{
+	if (scope->len == scope->cap) {
+		/* Slots that are not reserved by the compiler are rare, so we grow on the heap */
+		size_t new_cap = scope->cap < SCOPE_MIN_CAP ? SCOPE_MIN_CAP : scope->cap * 2;
+		SlashValue *values = malloc(sizeof(SlashValue) * new_cap);
+		StrView *names = malloc(sizeof(StrView) * new_cap);
+		if (scope->len != 0) {
+			memcpy(values, scope->values, sizeof(SlashValue) * scope->len);
+			memcpy(names, scope->names, sizeof(StrView) * scope->len);
+		}
+		if (scope->owns_slots) {
+			free(scope->values);
+			free(scope->names);
+		}
+		scope->values = values;
+		scope->names = names;
+		scope->cap = new_cap;
+		scope->owns_slots = true;
+	}
+
+	size_t slot = scope->len++;
+	scope->names[slot] = str_view_arena_copy(scope->arena_tmp.arena, *key);
+	scope->values[slot] = UNDEFINED_VAL;
+	if (scope->index != NULL)
+		hashmap_put(scope->index, scope->names[slot].view, (uint32_t)scope->names[slot].size,
+					&slot, sizeof(size_t), true);
+	return slot;
+}
+
 void scope_init_globals(Scope *scope, Arena *arena, int argc, char **argv)
 {
+	scope_init_slots(scope, NULL, NULL, 0);
 	scope->arena_tmp = m_arena_tmp_init(arena);
-	scope->enclosing = NULL;
-	scope->depth = 0;
-	hashmap_init(&scope->values);
+	scope->index = malloc(sizeof(HashMap));
+	hashmap_init(scope->index);
 	set_globals(scope);
 	scope_init_argv(scope, argc, argv);
 }
 
 void scope_init(Scope *scope, Scope *enclosing)
 {
-	scope->arena_tmp = m_arena_tmp_init(enclosing->arena_tmp.arena);
+	scope_init_slots(scope, enclosing, NULL, 0);
+}
+
+void scope_init_slots(Scope *scope, Scope *enclosing, StrView *reserved_names, size_t n_reserved)
+{
+	if (enclosing != NULL) {
+		scope->arena_tmp = m_arena_tmp_init(enclosing->arena_tmp.arena);
+		scope->depth = enclosing->depth + 1;
+	} else {
+		scope->depth = 0;
+	}
 	scope->enclosing = enclosing;
-	scope->depth = enclosing->depth + 1;
-	hashmap_init(&scope->values);
+	scope->names = reserved_names;
+	scope->len = n_reserved;
+	scope->cap = n_reserved;
+	scope->owns_slots = false;
+	scope->index = NULL;
+	if (n_reserved == 0) {
+		scope->values = NULL;
+		return;
+	}
+
+	scope->values = scope_alloc(scope, sizeof(SlashValue) * n_reserved);
+	for (size_t i = 0; i < n_reserved; i++)
+		scope->values[i] = UNDEFINED_VAL;
 }
 
 void scope_reset(Scope *scope)
 {
-	hashmap_free(&scope->values);
-	hashmap_init(&scope->values);
+	for (size_t i = 0; i < scope->len; i++)
+		scope->values[i] = UNDEFINED_VAL;
 }
 
 void scope_destroy(Scope *scope)
 {
-	hashmap_free(&scope->values);
+	if (scope->owns_slots) {
+		free(scope->values);
+		free(scope->names);
+	}
+	if (scope->index != NULL) {
+		hashmap_free(scope->index);
+		free(scope->index);
+	}
 	m_arena_tmp_release(scope->arena_tmp);
 }
 
@@ -126,32 +204,37 @@ void *scope_alloc(Scope *scope, size_t size)
 	return m_arena_alloc(scope->arena_tmp.arena, size);
 }
 
+size_t scope_reserve_slot(Scope *scope, StrView *key)
+{
+	ssize_t slot = scope_find_slot(scope, key);
+	if (slot == -1)
+		slot = scope_append_slot(scope, key);
+	return slot;
+}
+
 void var_define(Scope *scope, StrView *key, SlashValue *value)
 {
-	if (value == NULL) {
-		SlashValue none = { .T = &none_type_info };
-		hashmap_put(&scope->values, key->view, (uint32_t)key->size, &none, sizeof(SlashValue),
-					true);
-		return;
-	}
-	hashmap_put(&scope->values, key->view, (uint32_t)key->size, value, sizeof(SlashValue), true);
+	size_t slot = scope_reserve_slot(scope, key);
+
+	if (value == NULL)
+		scope->values[slot] = NoneSingleton;
+	else
+		scope->values[slot] = *value;
 }
 
 void var_assign(StrView *var_name, Scope *scope, SlashValue *value)
 {
-	hashmap_put(&scope->values, var_name->view, (uint32_t)var_name->size, value, sizeof(SlashValue),
-				true);
+	var_define(scope, var_name, value);
 }
 
 ScopeAndValue var_get(Scope *scope, StrView *key)
 {
-	SlashValue *value = NULL;
 	do {
-		value = hashmap_get(&scope->values, key->view, (uint32_t)key->size);
-		if (value != NULL)
-			return (ScopeAndValue){ .scope = scope, .value = value };
+		ssize_t slot = scope_find_slot(scope, key);
+		if (slot != -1 && !IS_UNDEFINED(scope->values[slot]))
+			return (ScopeAndValue){ .scope = scope, .value = &scope->values[slot] };
 		scope = scope->enclosing;
-	} while (value == NULL && scope != NULL);
+	} while (scope != NULL);
 
 	return (ScopeAndValue){ .scope = NULL, .value = NULL };
 }
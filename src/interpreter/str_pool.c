@@ -0,0 +1,78 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "interpreter/gc.h"
+#include "interpreter/interpreter.h"
+#include "interpreter/str_pool.h"
+#include "interpreter/value/slash_str.h"
+#include "nicc/nicc.h"
+
+
+void str_pool_init(StrPool *pool)
+{
+	hashmap_init(&pool->entries);
+	arraylist_init(&pool->all, sizeof(StrPoolEntry *));
+}
+
+void str_pool_free(StrPool *pool)
+{
+	/* the shared strs are GC objects and are freed by the GC */
+	for (size_t i = 0; i < pool->all.size; i++)
+		free(*(StrPoolEntry **)arraylist_get(&pool->all, i));
+	arraylist_free(&pool->all);
+	hashmap_free(&pool->entries);
+}
+
+StrPoolEntry *str_pool_intern(StrPool *pool, StrView *view)
+{
+	StrPoolEntry *entry = hashmap_get(&pool->entries, view->view, view->size);
+	if (entry != NULL)
+		return entry;
+
+	entry = malloc(sizeof(StrPoolEntry) + view->size);
+	memcpy(entry->text, view->view, view->size);
+	entry->view = (StrView){ .view = entry->text, .size = view->size };
+	entry->str = NULL;
+	/* the key is held by the entry, so it outlives the AST the literal was found in */
+	hashmap_put(&pool->entries, entry->text, view->size, entry, sizeof(StrPoolEntry), false);
+	arraylist_append(&pool->all, &entry);
+	return entry;
+}
+
+SlashStr *str_pool_get(Interpreter *interpreter, StrPoolEntry *entry)
+{
+	if (entry->str != NULL)
+		return entry->str;
+	/* the shared str is a root, so it must not be on the tmp arena */
+	assert(interpreter->gc.tmp_arena == NULL);
+	SlashStr *str = slash_str_new_from_view(interpreter, &entry->view);
+	str->literal = true;
+	entry->str = str;
+	return str;
+}
+
+SlashValue str_pool_unshare(Interpreter *interpreter, SlashValue value)
+{
+	if (!IS_STR(value) || !AS_STR(value)->literal)
+		return value;
+	/* a substr shares the buffer of a long literal until either is modified */
+	SlashStr *shared = AS_STR(value);
+	return AS_VALUE(slash_str_new_substr(interpreter, shared, 0, shared->len));
+}
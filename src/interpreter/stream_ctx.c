@@ -0,0 +1,71 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "interpreter/interpreter.h"
+#include "options.h"
+
+
+void stream_ctx_printf(StreamCtx *stream_ctx, const char *fmt, ...)
+{
+	if (stream_ctx->buf_fd != stream_ctx->out_fd) {
+		stream_ctx_flush(stream_ctx);
+		stream_ctx->buf_fd = stream_ctx->out_fd;
+	}
+
+	va_list args;
+	va_start(args, fmt);
+	size_t room = STREAM_BUF_SIZE - stream_ctx->buf_len;
+	int n = vsnprintf(stream_ctx->buf + stream_ctx->buf_len, room, fmt, args);
+	va_end(args);
+	if (n < 0)
+		return;
+	if ((size_t)n < room) {
+		stream_ctx->buf_len += n;
+		return;
+	}
+
+	/* did not fit, so the formatted output was truncated and has to be redone */
+	stream_ctx_flush(stream_ctx);
+	va_start(args, fmt);
+	if ((size_t)n < STREAM_BUF_SIZE) {
+		vsnprintf(stream_ctx->buf, STREAM_BUF_SIZE, fmt, args);
+		stream_ctx->buf_len = n;
+	} else {
+		vdprintf(stream_ctx->out_fd, fmt, args);
+	}
+	va_end(args);
+}
+
+void stream_ctx_flush(StreamCtx *stream_ctx)
+{
+	size_t written = 0;
+	while (written < stream_ctx->buf_len) {
+		ssize_t rc = write(stream_ctx->buf_fd, stream_ctx->buf + written,
+						   stream_ctx->buf_len - written);
+		if (rc == -1 && errno == EINTR)
+			continue;
+		/* nothing sensible to do if the reader is gone, so the output is dropped */
+		if (rc <= 0)
+			break;
+		written += rc;
+	}
+	stream_ctx->buf_len = 0;
+}
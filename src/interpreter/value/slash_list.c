@@ -62,6 +62,7 @@ bool slash_list_impl_set(Interpreter *interpreter, SlashList *list, SlashValue v
 
 	ensure_capacity(interpreter, list);
 	list->items[idx] = val;
+	gc_write_barrier(&interpreter->gc, &list->obj, val);
 	/* Only increase the length when we do not overwrite an existing item */
 	if (idx == list->len)
 		list->len++;
@@ -84,7 +85,7 @@ size_t slash_list_impl_index_of(SlashList *list, SlashValue val)
 {
 	for (size_t i = 0; i < list->len; i++) {
 		SlashValue other = list->items[i];
-		if (TYPE_EQ(val, other) && val.T->eq(val, other))
+		if (TYPE_EQ(val, other) && TYPE_OF(val)->eq(val, other))
 			return slash_list_impl_rm(list, i);
 	}
 	return SIZE_MAX;
@@ -28,18 +28,13 @@
 #include "nicc/nicc.h"
 
 
-static inline uint8_t map_hash_extra(int hash)
-{
-	return (uint8_t)(hash & ((1 << 8) - 1));
-}
-
-static SlashMapEntry *map_get_from_bucket(SlashMapBucket bucket, SlashValue key, uint8_t hash_extra)
+static SlashMapEntry *map_get_from_bucket(SlashMapBucket *bucket, SlashValue key, uint32_t hash)
 {
 	SlashMapEntry *entry = NULL;
 	for (size_t i = 0; i < HM_BUCKET_SIZE; i++) {
-		entry = &bucket.entries[i];
-		if (entry->is_occupied && entry->hash_extra == hash_extra && TYPE_EQ(key, entry->key)) {
-			if (key.T->eq(key, entry->key))
+		entry = &bucket->entries[i];
+		if (entry->is_occupied && entry->hash == hash && TYPE_EQ(key, entry->key)) {
+			if (TYPE_OF(key)->eq(key, entry->key))
 				return entry;
 		}
 	}
@@ -47,7 +42,7 @@ static SlashMapEntry *map_get_from_bucket(SlashMapBucket bucket, SlashValue key,
 	return NULL;
 }
 
-static int map_insert(SlashMapBucket *bucket, SlashValue key, SlashValue value, uint8_t hash_extra)
+static int map_insert(SlashMapBucket *bucket, SlashValue key, SlashValue value, uint32_t hash)
 {
 	/*
 	 * Hashmap implementation does not allow duplcate keys.
@@ -62,8 +57,8 @@ static int map_insert(SlashMapBucket *bucket, SlashValue key, SlashValue value,
 	for (size_t i = 0; i < HM_BUCKET_SIZE; i++) {
 		SlashMapEntry *entry = &bucket->entries[i];
 		/* Check if entry's key is equal to new key */
-		if (entry->is_occupied && entry->hash_extra == hash_extra && TYPE_EQ(entry->key, key)) {
-			if (key.T->eq(key, entry->key)) {
+		if (entry->is_occupied && entry->hash == hash && TYPE_EQ(entry->key, key)) {
+			if (TYPE_OF(key)->eq(key, entry->key)) {
 				found = entry;
 				override = true;
 				break;
@@ -78,7 +73,7 @@ static int map_insert(SlashMapBucket *bucket, SlashValue key, SlashValue value,
 		return _HM_FULL;
 
 	SlashMapEntry new_entry = {
-		.key = key, .value = value, .hash_extra = hash_extra, .is_occupied = true
+		.key = key, .value = value, .hash = hash, .is_occupied = true
 	};
 	*found = new_entry;
 	return override ? _HM_OVERRIDE : _HM_SUCCESS;
@@ -86,16 +81,16 @@ static int map_insert(SlashMapBucket *bucket, SlashValue key, SlashValue value,
 
 static void map_increase_capacity(Interpreter *interpreter, SlashMap *map)
 {
-	map->total_buckets_log2++;
-	assert(map->total_buckets_log2 < 32);
-
 	/*
 	 * The strategy here is to create more buckets and move each entry into one of the new buckets.
 	 * This causes a small freeze in execution. Could be improved by partially moving entries
 	 * sequentially. So far the added complexity is not worth it.
 	 */
-	size_t n_buckets = N_BUCKETS(map->total_buckets_log2);
+	size_t n_buckets = N_BUCKETS(map->total_buckets_log2 + 1);
+	/* the GC may run here and trace the map, so the map must stay as is until we have the memory */
 	SlashMapBucket *new_buckets = gc_alloc(interpreter, sizeof(SlashMapBucket) * n_buckets);
+	map->total_buckets_log2++;
+	assert(map->total_buckets_log2 < 32);
 	/* Sets all entries' is_occupied field to false (0) */
 	memset(new_buckets, 0, sizeof(SlashMapBucket) * n_buckets);
 
@@ -106,10 +101,9 @@ static void map_increase_capacity(Interpreter *interpreter, SlashMap *map)
 		for (int j = 0; j < HM_BUCKET_SIZE; j++) {
 			SlashMapEntry entry = bucket->entries[j];
 			if (entry.is_occupied) {
-				unsigned int hash = (unsigned int)entry.key.T->hash(entry.key);
-				uint8_t hash_extra = map_hash_extra(hash);
-				unsigned int bucket_idx = hash >> (32 - map->total_buckets_log2);
-				map_insert(&new_buckets[bucket_idx], entry.key, entry.value, hash_extra);
+				/* the hash is kept in the entry, so keys are not hashed again */
+				unsigned int bucket_idx = entry.hash >> (32 - map->total_buckets_log2);
+				map_insert(&new_buckets[bucket_idx], entry.key, entry.value, entry.hash);
 			}
 		}
 	}
@@ -143,18 +137,19 @@ void slash_map_impl_put(Interpreter *interpreter, SlashMap *map, SlashValue key,
 		map_increase_capacity(interpreter, map);
 
 	VERIFY_TRAIT_IMPL(hash, key, "Can not use type '%s' as key in map because type is unhashable.",
-					  key.T->name);
-	unsigned int hash = (unsigned int)key.T->hash(key);
-	uint8_t hash_extra = map_hash_extra(hash);
+					  TYPE_OF(key)->name);
+	uint32_t hash = (uint32_t)TYPE_OF(key)->hash(key);
 	unsigned int bucket_idx = hash >> (32 - map->total_buckets_log2);
 
-	int rc = map_insert(&map->buckets[bucket_idx], key, value, hash_extra);
+	int rc = map_insert(&map->buckets[bucket_idx], key, value, hash);
 	if (rc == _HM_FULL) {
 		map_increase_capacity(interpreter, map);
 		slash_map_impl_put(interpreter, map, key, value);
 	}
 	if (rc == _HM_SUCCESS)
 		map->len++;
+	gc_write_barrier(&interpreter->gc, &map->obj, key);
+	gc_write_barrier(&interpreter->gc, &map->obj, value);
 }
 
 SlashValue slash_map_impl_get(SlashMap *map, SlashValue key)
@@ -163,12 +158,11 @@ SlashValue slash_map_impl_get(SlashMap *map, SlashValue key)
 		return NoneSingleton;
 
 	VERIFY_TRAIT_IMPL(hash, key, "Can not use type '%s' as key in map because type is unhashable.",
-					  key.T->name);
-	unsigned int hash = (unsigned int)key.T->hash(key);
-	uint8_t hash_extra = map_hash_extra(hash);
+					  TYPE_OF(key)->name);
+	uint32_t hash = (uint32_t)TYPE_OF(key)->hash(key);
 	unsigned int bucket_idx = hash >> (32 - map->total_buckets_log2);
 
-	SlashMapEntry *entry = map_get_from_bucket(map->buckets[bucket_idx], key, hash_extra);
+	SlashMapEntry *entry = map_get_from_bucket(&map->buckets[bucket_idx], key, hash);
 	if (entry == NULL)
 		return NoneSingleton;
 
@@ -228,9 +222,9 @@ void slash_map_impl_print(Interpreter *interpreter, SlashMap map)
 			key = entry.key;
 			value = entry.value;
 
-			key.T->print(interpreter, key);
+			TYPE_OF(key)->print(interpreter, key);
 			SLASH_PRINT(&interpreter->stream_ctx, ": ");
-			value.T->print(interpreter, value);
+			TYPE_OF(value)->print(interpreter, value);
 			if (entries_found == map.len)
 				break;
 			SLASH_PRINT(&interpreter->stream_ctx, ",");
@@ -14,6 +14,7 @@
  *  You should have received a copy of the GNU General Public License
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#define _GNU_SOURCE // memmem
 #include <assert.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -25,28 +26,141 @@
 #include "interpreter/value/slash_str.h"
 #include "interpreter/value/slash_value.h"
 #include "lib/str_view.h"
+#include "options.h"
 
 
-void slash_str_init_from_view(Interpreter *interpreter, SlashStr *str, StrView *view)
+/* Gives str a new buffer with room for cap bytes, and len bytes in use */
+static void str_buf_new(Interpreter *interpreter, SlashStr *str, size_t len, size_t cap)
 {
-	str->len = view->size;
-	str->str = gc_alloc(interpreter, str->len + 1);
-	memcpy(str->str, view->view, str->len);
-	str->str[str->len] = 0;
+	assert(cap > len);
+	SlashStrBuf *buf = gc_alloc(interpreter, sizeof(SlashStrBuf) + cap);
+	buf->refs = 1;
+	buf->cap = cap;
+	buf->used = len;
+	buf->data[len] = 0;
+	str->buf = buf;
+	str->str = buf->data;
+	str->len = len;
 }
 
-void slash_str_init_from_slice(Interpreter *interpreter, SlashStr *str, char *cstr, size_t size)
+static void str_buf_release(Interpreter *interpreter, SlashStrBuf *buf)
 {
-	slash_str_init_from_view(interpreter, str, &(StrView){ .view = cstr, .size = size });
+	if (--buf->refs == 0)
+		gc_free(interpreter, buf, sizeof(SlashStrBuf) + buf->cap);
 }
 
-void slash_str_init_from_concat(Interpreter *interpreter, SlashStr *str, SlashStr *a, SlashStr *b)
+/* Allocates a str with room for len characters after the header, which str points to */
+static SlashStr *str_new_inline(Interpreter *interpreter, size_t len)
 {
-	str->len = a->len + b->len;
-	str->str = gc_alloc(interpreter, str->len + 1);
+	SlashStr *str =
+		(SlashStr *)gc_new_T_sized(interpreter, &str_type_info, sizeof(SlashStr) + len + 1);
+	str->str = str->data;
+	str->len = len;
+	str->str[len] = 0;
+	return str;
+}
+
+/*
+ * Allocates a str with len characters in a new buffer. A managed str gets room for cap bytes,
+ * an unmanaged one only what it holds since it is never appended to in place.
+ */
+static SlashStr *str_new_buffered(Interpreter *interpreter, size_t len, size_t cap)
+{
+	SlashStr *str = (SlashStr *)gc_new_T(interpreter, &str_type_info);
+	if (!str->obj.gc_managed) {
+		str_buf_new(interpreter, str, len, len + 1);
+		return str;
+	}
+	gc_shadow_push(&interpreter->gc, &str->obj);
+	str_buf_new(interpreter, str, len, cap);
+	gc_shadow_pop(&interpreter->gc);
+	return str;
+}
+
+SlashStr *slash_str_new_from_view(Interpreter *interpreter, StrView *view)
+{
+	SlashStr *str = view->size < STR_INLINE_MAX
+						? str_new_inline(interpreter, view->size)
+						: str_new_buffered(interpreter, view->size, view->size + 1);
+	memcpy(str->str, view->view, view->size);
+	return str;
+}
+
+SlashStr *slash_str_new_from_slice(Interpreter *interpreter, char *cstr, size_t size)
+{
+	return slash_str_new_from_view(interpreter, &(StrView){ .view = cstr, .size = size });
+}
+
+SlashStr *slash_str_new_from_concat(Interpreter *interpreter, SlashStr *a, SlashStr *b)
+{
+	size_t len = a->len + b->len;
+	SlashStrBuf *buf = a->buf;
+	/* append in place when nothing follows a in its buffer */
+	bool in_place = a->obj.gc_managed && buf != NULL && a->str + a->len == buf->data + buf->used &&
+					buf->used + b->len < buf->cap;
+	if (!in_place && len < STR_INLINE_MAX) {
+		SlashStr *str = str_new_inline(interpreter, len);
+		memcpy(str->str, a->str, a->len);
+		memcpy(str->str + a->len, b->str, b->len);
+		return str;
+	}
+
+	/*
+	 * A managed str gets room to grow to twice its length, so appending to it repeatedly copies
+	 * each character a constant number of times on average.
+	 */
+	if (!in_place) {
+		SlashStr *str = str_new_buffered(interpreter, len, 2 * len + 1);
+		memcpy(str->str, a->str, a->len);
+		memcpy(str->str + a->len, b->str, b->len);
+		return str;
+	}
+
+	SlashStr *str = (SlashStr *)gc_new_T(interpreter, &str_type_info);
+	/* unmanaged strs are never swept to release their buffer, so they do not share buffers */
+	if (str->obj.gc_managed) {
+		memcpy(buf->data + buf->used, b->str, b->len);
+		buf->used += b->len;
+		buf->data[buf->used] = 0;
+		buf->refs++;
+		str->buf = buf;
+		str->str = a->str;
+		str->len = len;
+		return str;
+	}
+
+	str_buf_new(interpreter, str, len, len + 1);
 	memcpy(str->str, a->str, a->len);
 	memcpy(str->str + a->len, b->str, b->len);
-	str->str[str->len] = 0;
+	return str;
+}
+
+SlashStr *slash_str_new_substr(Interpreter *interpreter, SlashStr *str, size_t start, size_t len)
+{
+	assert(start + len <= str->len);
+	if (str->buf == NULL)
+		return slash_str_new_from_slice(interpreter, str->str + start, len);
+
+	SlashStr *substr = (SlashStr *)gc_new_T(interpreter, &str_type_info);
+	if (!substr->obj.gc_managed) {
+		str_buf_new(interpreter, substr, len, len + 1);
+		memcpy(substr->str, str->str + start, len);
+		return substr;
+	}
+	/* str is reachable through the caller, so its buffer outlives the allocation above */
+	str->buf->refs++;
+	substr->buf = str->buf;
+	substr->str = str->str + start;
+	substr->len = len;
+	return substr;
+}
+
+SlashStr *slash_str_new_from_malloced(Interpreter *interpreter, char *buf, size_t len)
+{
+	/* the GC allocates from its own pool, so the buffer is copied over */
+	SlashStr *str = slash_str_new_from_slice(interpreter, buf, len);
+	free(buf);
+	return str;
 }
 
 void slash_str_init_from_alloced_cstr(SlashStr *str, char *cstr)
@@ -54,24 +168,69 @@ void slash_str_init_from_alloced_cstr(SlashStr *str, char *cstr)
 	assert(cstr != NULL);
 	str->len = strlen(cstr);
 	str->str = cstr;
+	str->buf = NULL;
+	str->hash = 0;
 	str->obj.gc_managed = false;
 }
 
-static char *split_single(char *str, char *chars)
+void slash_str_free(Interpreter *interpreter, SlashStr *str)
+{
+	if (str->buf != NULL)
+		str_buf_release(interpreter, str->buf);
+}
+
+size_t slash_str_obj_size(SlashStr *str)
+{
+	if (str->str == str->data)
+		return sizeof(SlashStr) + str->len + 1;
+	return sizeof(SlashStr);
+}
+
+void slash_str_make_private(Interpreter *interpreter, SlashStr *str)
 {
-	size_t offset = 0;
-	size_t split_chars = strlen(chars);
-	while (str[offset] != 0) {
-		for (size_t i = 0; i < split_chars; i++) {
-			if (str[offset] == chars[i])
-				return str + offset;
-		}
-		offset++;
+	if (str->buf == NULL)
+		return;
+	if (str->buf->refs == 1) {
+		/* the strs that were appended to str are gone, so str ends the buffer again */
+		str->buf->used = str->str + str->len - str->buf->data;
+		str->str[str->len] = 0;
+		return;
 	}
+	assert(str->obj.gc_managed);
+	char *old = str->str;
+	SlashStrBuf *old_buf = str->buf;
+	/* str keeps the old buffer referenced until its characters are copied */
+	str_buf_new(interpreter, str, str->len, str->len + 1);
+	memcpy(str->str, old, str->len);
+	str_buf_release(interpreter, old_buf);
+}
+
+char *slash_str_cstr(Interpreter *interpreter, SlashStr *str)
+{
+	/* a str that has been appended to in place is followed by the characters appended */
+	if (str->str[str->len] != 0)
+		slash_str_make_private(interpreter, str);
+	return str->str;
+}
 
+/* Returns the first of chars in [str, end), or NULL */
+static char *split_single(char *str, char *end, char *chars, size_t chars_len)
+{
+	for (; str < end; str++) {
+		if (memchr(chars, *str, chars_len) != NULL)
+			return str;
+	}
 	return NULL;
 }
 
+static char *next_separator(char *str, char *end, char *separator, size_t separator_len,
+							bool split_any)
+{
+	if (split_any)
+		return split_single(str, end, separator, separator_len);
+	return memmem(str, end - str, separator, separator_len);
+}
+
 SlashList *slash_str_split(Interpreter *interpreter, SlashStr *str, char *separator, bool split_any)
 {
 	SlashList *list = (SlashList *)gc_new_T(interpreter, &list_type_info);
@@ -80,23 +239,27 @@ SlashList *slash_str_split(Interpreter *interpreter, SlashStr *str, char *separa
 
 	size_t separator_len = strlen(separator);
 	char *start_ptr = str->str;
-	char *end_ptr = split_any ? split_single(start_ptr, separator) : strstr(start_ptr, separator);
+	char *str_end = str->str + str->len;
+	char *end_ptr = next_separator(start_ptr, str_end, separator, separator_len, split_any);
 	while (end_ptr != NULL) {
-		/* save substr */
-		SlashStr *substr = (SlashStr *)gc_new_T(interpreter, &str_type_info);
-		slash_str_init_from_slice(interpreter, substr, start_ptr, end_ptr - start_ptr);
+		/* save substr, which stays reachable while appending may run the GC */
+		SlashStr *substr =
+			slash_str_new_substr(interpreter, str, start_ptr - str->str, end_ptr - start_ptr);
+		gc_shadow_push(&interpreter->gc, &substr->obj);
 		slash_list_impl_append(interpreter, list, AS_VALUE(substr));
+		gc_shadow_pop(&interpreter->gc);
 		/* continue */
 		start_ptr = end_ptr + (split_any ? 1 : separator_len);
-		end_ptr = split_any ? split_single(start_ptr, separator) : strstr(start_ptr, separator);
+		end_ptr = next_separator(start_ptr, str_end, separator, separator_len, split_any);
 	}
 
 	/* final substr */
-	size_t final_size = (str->str + str->len) - start_ptr;
+	size_t final_size = str_end - start_ptr;
 	if (final_size != 0) {
-		SlashStr *substr = (SlashStr *)gc_new_T(interpreter, &str_type_info);
-		slash_str_init_from_slice(interpreter, substr, start_ptr, final_size);
+		SlashStr *substr = slash_str_new_substr(interpreter, str, start_ptr - str->str, final_size);
+		gc_shadow_push(&interpreter->gc, &substr->obj);
 		slash_list_impl_append(interpreter, list, AS_VALUE(substr));
+		gc_shadow_pop(&interpreter->gc);
 	}
 
 	gc_shadow_pop(&interpreter->gc);
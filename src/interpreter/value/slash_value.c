@@ -14,7 +14,7 @@
  *  You should have received a copy of the GNU General Public License
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
-
+#define _GNU_SOURCE // memmem
 #include <assert.h>
 #include <math.h>
 #include <stdbool.h>
@@ -42,23 +42,23 @@
 SlashValue bool_unary_not(SlashValue self)
 {
 	assert(IS_BOOL(self));
-	return (SlashValue){ .T = &bool_type_info, .boolean = !self.boolean };
+	return BOOL_VAL(!AS_BOOL(self));
 }
 
 void bool_print(Interpreter *interpreter, SlashValue self)
 {
 	assert(IS_BOOL(self));
-	SLASH_PRINT(&interpreter->stream_ctx, "%s", self.boolean == true ? "true" : "false");
+	SLASH_PRINT(&interpreter->stream_ctx, "%s", AS_BOOL(self) == true ? "true" : "false");
 }
 
 SlashValue bool_to_str(Interpreter *interpreter, SlashValue self)
 {
 	assert(IS_BOOL(self));
-	SlashObj *str = gc_new_T(interpreter, &str_type_info);
-	if (self.boolean)
-		slash_str_init_from_slice(interpreter, (SlashStr *)str, "true", 4);
+	SlashStr *str;
+	if (AS_BOOL(self))
+		str = slash_str_new_from_slice(interpreter, "true", 4);
 	else
-		slash_str_init_from_slice(interpreter, (SlashStr *)str, "false", 5);
+		str = slash_str_new_from_slice(interpreter, "false", 5);
 
 	return AS_VALUE(str);
 }
@@ -67,24 +67,24 @@ SlashValue bool_to_str(Interpreter *interpreter, SlashValue self)
 bool bool_truthy(SlashValue self)
 {
 	assert(IS_BOOL(self));
-	return self.boolean;
+	return AS_BOOL(self);
 }
 
 bool bool_eq(SlashValue self, SlashValue other)
 {
 	assert(IS_BOOL(self) && IS_BOOL(other));
-	return self.boolean == other.boolean;
+	return AS_BOOL(self) == AS_BOOL(other);
 }
 
 int bool_cmp(SlashValue self, SlashValue other)
 {
 	assert(IS_BOOL(self) && IS_BOOL(other));
-	return self.boolean > other.boolean;
+	return AS_BOOL(self) > AS_BOOL(other);
 }
 
 int bool_hash(SlashValue self)
 {
-	return self.boolean;
+	return AS_BOOL(self);
 }
 
 
@@ -96,105 +96,104 @@ SlashValue num_plus(Interpreter *interpreter, SlashValue self, SlashValue other)
 	(void)interpreter;
 	assert(IS_NUM(self) && IS_NUM(other));
 	// TODO: check for overflow and other undefined behaviour. Same for all arithmetic operators.
-	return (SlashValue){ .T = &num_type_info, .num = self.num + other.num };
+	return NUM_VAL(AS_NUM(self) + AS_NUM(other));
 }
 
 SlashValue num_minus(SlashValue self, SlashValue other)
 {
 	assert(IS_NUM(self) && IS_NUM(other));
-	return (SlashValue){ .T = &num_type_info, .num = self.num - other.num };
+	return NUM_VAL(AS_NUM(self) - AS_NUM(other));
 }
 
 SlashValue num_mul(Interpreter *interpreter, SlashValue self, SlashValue other)
 {
 	(void)interpreter;
 	assert(IS_NUM(self) && IS_NUM(other));
-	return (SlashValue){ .T = &num_type_info, .num = self.num * other.num };
+	return NUM_VAL(AS_NUM(self) * AS_NUM(other));
 }
 
 SlashValue num_div(SlashValue self, SlashValue other)
 {
 	assert(IS_NUM(self) && IS_NUM(other));
-	if (other.num == 0)
+	if (AS_NUM(other) == 0)
 		REPORT_RUNTIME_ERROR_OPAQUE("Division by zero error");
-	return (SlashValue){ .T = &num_type_info, .num = self.num / other.num };
+	return NUM_VAL(AS_NUM(self) / AS_NUM(other));
 }
 
 SlashValue num_int_div(SlashValue self, SlashValue other)
 {
 	assert(IS_NUM(self) && IS_NUM(other));
-	if (other.num == 0)
+	if (AS_NUM(other) == 0)
 		REPORT_RUNTIME_ERROR_OPAQUE("Division by zero error");
-	return (SlashValue){ .T = &num_type_info, .num = (int)(self.num / other.num) };
+	return NUM_VAL((int)(AS_NUM(self) / AS_NUM(other)));
 }
 
 SlashValue num_pow(SlashValue self, SlashValue other)
 {
 	assert(IS_NUM(self) && IS_NUM(other));
-	return (SlashValue){ .T = &num_type_info, .num = pow(self.num, other.num) };
+	return NUM_VAL(pow(AS_NUM(self), AS_NUM(other)));
 }
 
 SlashValue num_mod(SlashValue self, SlashValue other)
 {
 	assert(IS_NUM(self) && IS_NUM(other));
-	if (other.num == 0)
+	if (AS_NUM(other) == 0)
 		REPORT_RUNTIME_ERROR_OPAQUE("Modulo by zero error");
-	double m = fmod(self.num, other.num);
+	double m = fmod(AS_NUM(self), AS_NUM(other));
 	/* same behaviour as we tend to see in maths */
-	m = m < 0 && other.num > 0 ? m + other.num : m;
-	return (SlashValue){ .T = &num_type_info, .num = m };
+	m = m < 0 && AS_NUM(other) > 0 ? m + AS_NUM(other) : m;
+	return NUM_VAL(m);
 }
 
 SlashValue num_unary_minus(SlashValue self)
 {
 	assert(IS_NUM(self));
-	return (SlashValue){ .T = &num_type_info, .num = -self.num };
+	return NUM_VAL(-AS_NUM(self));
 }
 
 SlashValue num_unary_not(SlashValue self)
 {
 	assert(IS_NUM(self));
-	TraitTruthy is_truthy = self.T->truthy;
-	return (SlashValue){ .T = &bool_type_info, .boolean = !is_truthy(self) };
+	TraitTruthy is_truthy = TYPE_OF(self)->truthy;
+	return BOOL_VAL(!is_truthy(self));
 }
 
 void num_print(Interpreter *interpreter, SlashValue self)
 {
 	assert(IS_NUM(self));
-	if (self.num == (int)self.num)
-		SLASH_PRINT(&interpreter->stream_ctx, "%d", (int)self.num);
+	if (AS_NUM(self) == (int)AS_NUM(self))
+		SLASH_PRINT(&interpreter->stream_ctx, "%d", (int)AS_NUM(self));
 	else
-		SLASH_PRINT(&interpreter->stream_ctx, "%f", self.num);
+		SLASH_PRINT(&interpreter->stream_ctx, "%f", AS_NUM(self));
 }
 
 SlashValue num_to_str(Interpreter *interpreter, SlashValue self)
 {
 	assert(IS_NUM(self));
-	SlashObj *str = gc_new_T(interpreter, &str_type_info);
 	char buffer[256];
-	int len = sprintf(buffer, "%f", self.num);
-	slash_str_init_from_slice(interpreter, (SlashStr *)str, buffer, len);
+	int len = sprintf(buffer, "%f", AS_NUM(self));
+	SlashStr *str = slash_str_new_from_slice(interpreter, buffer, len);
 	return AS_VALUE(str);
 }
 
 bool num_truthy(SlashValue self)
 {
 	assert(IS_NUM(self));
-	return self.num != 0;
+	return AS_NUM(self) != 0;
 }
 
 bool num_eq(SlashValue self, SlashValue other)
 {
 	assert(IS_NUM(self) && IS_NUM(other));
-	return self.num == other.num;
+	return AS_NUM(self) == AS_NUM(other);
 }
 
 int num_cmp(SlashValue self, SlashValue other)
 {
 	assert(IS_NUM(self) && IS_NUM(other));
-	if (self.num > other.num)
+	if (AS_NUM(self) > AS_NUM(other))
 		return 1;
-	if (self.num < other.num)
+	if (AS_NUM(self) < AS_NUM(other))
 		return -1;
 	return 0;
 }
@@ -202,14 +201,14 @@ int num_cmp(SlashValue self, SlashValue other)
 int num_hash(SlashValue self)
 {
 	assert(IS_NUM(self));
-	if (self.num == (int)self.num)
-		return self.num;
+	if (AS_NUM(self) == (int)AS_NUM(self))
+		return AS_NUM(self);
 	/* cursed */
 	union long_or_d {
 		long l;
 		double d;
 	};
-	union long_or_d iod = { .d = self.num };
+	union long_or_d iod = { .d = AS_NUM(self) };
 	return (int)iod.l;
 }
 
@@ -220,16 +219,15 @@ int num_hash(SlashValue self)
 void range_print(Interpreter *interpreter, SlashValue self)
 {
 	assert(IS_RANGE(self));
-	SLASH_PRINT(&interpreter->stream_ctx, "%d -> %d", self.range.start, self.range.end);
+	SLASH_PRINT(&interpreter->stream_ctx, "%d -> %d", AS_RANGE(self)->start, AS_RANGE(self)->end);
 }
 
 SlashValue range_to_str(Interpreter *interpreter, SlashValue self)
 {
 	assert(IS_RANGE(self));
-	SlashObj *str = gc_new_T(interpreter, &str_type_info);
 	char buffer[512];
-	int len = sprintf(buffer, "%d -> %d", self.range.start, self.range.end);
-	slash_str_init_from_slice(interpreter, (SlashStr *)str, buffer, len);
+	int len = sprintf(buffer, "%d -> %d", AS_RANGE(self)->start, AS_RANGE(self)->end);
+	SlashStr *str = slash_str_new_from_slice(interpreter, buffer, len);
 	return AS_VALUE(str);
 }
 
@@ -239,21 +237,23 @@ SlashValue range_item_get(Interpreter *interpreter, SlashValue self, SlashValue
 	assert(IS_RANGE(self));
 	if (IS_NUM(other)) {
 		if (!NUM_IS_INT(other))
-			REPORT_RUNTIME_ERROR("Range index can not be a floating point number: '%f", other.num);
-		size_t idx = other.num;
-		size_t range_size = self.range.start > self.range.end ? self.range.start - self.range.end
-															  : self.range.end - self.range.start;
+			REPORT_RUNTIME_ERROR("Range index can not be a floating point number: '%f",
+								 AS_NUM(other));
+		SlashRange *range = AS_RANGE(self);
+		size_t idx = AS_NUM(other);
+		size_t range_size =
+			range->start > range->end ? range->start - range->end : range->end - range->start;
 		if (idx >= range_size)
 			REPORT_RUNTIME_ERROR(
 				"Range index out of range. Has size '%zu', tried to get item at index '%zu'",
 				range_size, idx);
 
 		int offset;
-		if (self.range.end > self.range.start)
-			offset = self.range.start + idx;
+		if (range->end > range->start)
+			offset = range->start + idx;
 		else
-			offset = self.range.start - idx;
-		return (SlashValue){ .T = &num_type_info, .num = offset };
+			offset = range->start - idx;
+		return NUM_VAL(offset);
 	}
 
 	REPORT_RUNTIME_ERROR("TODO: implement item get on range for type range");
@@ -268,8 +268,8 @@ bool range_item_in(SlashValue self, SlashValue other)
 	if (!NUM_IS_INT(other))
 		return false;
 
-	int offset = self.range.start + other.num;
-	return offset < self.range.end;
+	int offset = AS_RANGE(self)->start + AS_NUM(other);
+	return offset < AS_RANGE(self)->end;
 }
 
 bool range_truthy(SlashValue self)
@@ -281,7 +281,17 @@ bool range_truthy(SlashValue self)
 bool range_eq(SlashValue self, SlashValue other)
 {
 	assert(IS_RANGE(self) && IS_RANGE(other));
-	return self.range.start == other.range.start && self.range.end == other.range.end;
+	SlashRange *a = AS_RANGE(self);
+	SlashRange *b = AS_RANGE(other);
+	return a->start == b->start && a->end == b->end;
+}
+
+SlashValue slash_range_new(Interpreter *interpreter, int32_t start, int32_t end)
+{
+	SlashRange *range = (SlashRange *)gc_new_T(interpreter, &range_type_info);
+	range->start = start;
+	range->end = end;
+	return AS_VALUE(range);
 }
 
 
@@ -291,7 +301,7 @@ bool range_eq(SlashValue self, SlashValue other)
 SlashValue text_lit_to_str(Interpreter *interpreter, SlashValue self)
 {
 	assert(IS_TEXT_LIT(self));
-	StrView tl = self.text_lit;
+	StrView tl = *AS_TEXT_LIT(self);
 	ArenaTmp tmp = m_arena_tmp_init(&interpreter->arena);
 	StrBuilder sb;
 	str_builder_init(&sb, tmp.arena);
@@ -311,9 +321,8 @@ SlashValue text_lit_to_str(Interpreter *interpreter, SlashValue self)
 		str_builder_append_char(&sb, c);
 	}
 
-	SlashObj *str = gc_new_T(interpreter, &str_type_info);
 	StrView built = str_builder_complete(&sb);
-	slash_str_init_from_view(interpreter, (SlashStr *)str, &built);
+	SlashStr *str = slash_str_new_from_view(interpreter, &built);
 	m_arena_tmp_release(tmp);
 
 	return AS_VALUE(str);
@@ -337,7 +346,7 @@ void function_print(Interpreter *interpreter, SlashValue self)
 SlashValue map_unary_not(SlashValue self)
 {
 	assert(IS_MAP(self));
-	return (SlashValue){ .T = &bool_type_info, .boolean = !self.T->truthy(self) };
+	return BOOL_VAL(!TYPE_OF(self)->truthy(self));
 }
 
 void map_print(Interpreter *interpreter, SlashValue self)
@@ -364,7 +373,7 @@ void map_item_assign(Interpreter *interpreter, SlashValue self, SlashValue index
 bool map_item_in(SlashValue self, SlashValue other)
 {
 	assert(IS_MAP(self));
-	return slash_map_impl_get(AS_MAP(self), other).T != &none_type_info;
+	return !IS_NONE(slash_map_impl_get(AS_MAP(self), other));
 }
 
 bool map_truthy(SlashValue self)
@@ -389,7 +398,7 @@ bool map_eq(SlashValue self, SlashValue other)
 		SlashValue entry_b = slash_map_impl_get(b, keys[i]);
 		if (!TYPE_EQ(entry_a, entry_b))
 			return false;
-		if (!entry_a.T->eq(entry_a, entry_b))
+		if (!TYPE_OF(entry_a)->eq(entry_a, entry_b))
 			return false;
 	}
 
@@ -405,8 +414,8 @@ SlashValue list_plus(Interpreter *interpreter, SlashValue self, SlashValue other
 	// TODO: 1. We can prealloc the memory since we know the size
 	//       2. We can use something like memcpy to copy all data in one batch
 	assert(IS_LIST(self) && IS_LIST(self));
-	SlashList *new_list = (SlashList *)gc_new_T(interpreter, &list_type_info);
 	gc_barrier_start(&interpreter->gc);
+	SlashList *new_list = (SlashList *)gc_new_T(interpreter, &list_type_info);
 	slash_list_impl_init(interpreter, new_list);
 
 	SlashList *a = AS_LIST(self);
@@ -424,7 +433,7 @@ SlashValue list_plus(Interpreter *interpreter, SlashValue self, SlashValue other
 SlashValue list_unary_not(SlashValue self)
 {
 	assert(IS_LIST(self));
-	return (SlashValue){ .T = &bool_type_info, .boolean = !self.T->truthy(self) };
+	return BOOL_VAL(!TYPE_OF(self)->truthy(self));
 }
 
 void list_print(Interpreter *interpreter, SlashValue self)
@@ -434,8 +443,8 @@ void list_print(Interpreter *interpreter, SlashValue self)
 	SLASH_PRINT(&interpreter->stream_ctx, "[");
 	for (size_t i = 0; i < underlying->len; i++) {
 		SlashValue item = underlying->items[i];
-		assert(item.T->print != NULL);
-		item.T->print(interpreter, item);
+		assert(TYPE_OF(item)->print != NULL);
+		TYPE_OF(item)->print(interpreter, item);
 		if (i != underlying->len - 1)
 			SLASH_PRINT(&interpreter->stream_ctx, ", ");
 	}
@@ -451,10 +460,10 @@ SlashValue list_item_get(Interpreter *interpreter, SlashValue self, SlashValue o
 	assert(IS_LIST(self));
 	assert(IS_NUM(other)); // TODO: implement for range
 	if (!NUM_IS_INT(other))
-		REPORT_RUNTIME_ERROR("List index can not be a floating point number: '%f'", other.num);
+		REPORT_RUNTIME_ERROR("List index can not be a floating point number: '%f'", AS_NUM(other));
 
 	SlashList *list = AS_LIST(self);
-	int index = (int)other.num;
+	int index = (int)AS_NUM(other);
 	if (index < 0 || (size_t)index >= list->len)
 		REPORT_RUNTIME_ERROR("List index '%d' out of range for list with len '%zu'", index,
 							 list->len);
@@ -468,10 +477,10 @@ void list_item_assign(Interpreter *interpreter, SlashValue self, SlashValue inde
 	assert(IS_LIST(self));
 	assert(IS_NUM(index)); // TODO: implement for range
 	if (!NUM_IS_INT(index))
-		REPORT_RUNTIME_ERROR("List index can not be a floating point number: '%f'", index.num);
+		REPORT_RUNTIME_ERROR("List index can not be a floating point number: '%f'", AS_NUM(index));
 
 	SlashList *list = AS_LIST(self);
-	int idx = (int)index.num;
+	int idx = (int)AS_NUM(index);
 	if (idx < 0 || (size_t)idx >= list->len)
 		REPORT_RUNTIME_ERROR("List index '%d' out of range for list with len '%zu'", idx,
 							 list->len);
@@ -507,7 +516,7 @@ bool list_eq(SlashValue self, SlashValue other)
 		if (!TYPE_EQ(A, B))
 			return false;
 		/* Know A and B have the same types */
-		TraitEq item_eq = A.T->eq;
+		TraitEq item_eq = TYPE_OF(A)->eq;
 		if (!item_eq(A, B))
 			return false;
 	}
@@ -521,11 +530,14 @@ bool list_eq(SlashValue self, SlashValue other)
  */
 void slash_tuple_init(Interpreter *interpreter, SlashTuple *tuple, size_t size)
 {
-	tuple->len = size;
-	if (size == 0)
+	if (size == 0) {
 		tuple->items = NULL;
-	else
+	} else {
 		tuple->items = gc_alloc(interpreter, sizeof(SlashValue) * size);
+		/* the items are filled in later and may be traced before that. All zero bits is a num */
+		memset(tuple->items, 0, sizeof(SlashValue) * size);
+	}
+	tuple->len = size;
 }
 
 SlashValue tuple_plus(Interpreter *interpreter, SlashValue self, SlashValue other)
@@ -548,7 +560,7 @@ SlashValue tuple_plus(Interpreter *interpreter, SlashValue self, SlashValue othe
 SlashValue tuple_unary_not(SlashValue self)
 {
 	assert(IS_TUPLE(self));
-	return (SlashValue){ .T = &bool_type_info, .boolean = !self.T->truthy(self) };
+	return BOOL_VAL(!TYPE_OF(self)->truthy(self));
 }
 
 void tuple_print(Interpreter *interpreter, SlashValue self)
@@ -558,7 +570,7 @@ void tuple_print(Interpreter *interpreter, SlashValue self)
 	SLASH_PRINT(&interpreter->stream_ctx, "(");
 	for (size_t i = 0; i < tuple->len; i++) {
 		SlashValue this = tuple->items[i];
-		this.T->print(interpreter, this);
+		TYPE_OF(this)->print(interpreter, this);
 		if (i != tuple->len - 1 || i == 0)
 			SLASH_PRINT(&interpreter->stream_ctx, ",");
 	}
@@ -573,10 +585,10 @@ SlashValue tuple_item_get(Interpreter *interpreter, SlashValue self, SlashValue
 	assert(IS_TUPLE(self));
 	assert(IS_NUM(other)); // TODO: implement for range
 	if (!NUM_IS_INT(other))
-		REPORT_RUNTIME_ERROR("Tuple index can not be a floating point number: '%f'", other.num);
+		REPORT_RUNTIME_ERROR("Tuple index can not be a floating point number: '%f'", AS_NUM(other));
 
 	SlashTuple *tuple = AS_TUPLE(self);
-	int index = (int)other.num;
+	int index = (int)AS_NUM(other);
 	if (index < 0 || (size_t)index >= tuple->len)
 		REPORT_RUNTIME_ERROR("Tuple index '%d' out of range for list with len '%zu'", index,
 							 tuple->len);
@@ -593,7 +605,7 @@ bool tuple_item_in(SlashValue self, SlashValue other)
 		SlashValue this = tuple->items[i];
 		if (!TYPE_EQ(this, other))
 			continue;
-		if (this.T->eq(this, other))
+		if (TYPE_OF(this)->eq(this, other))
 			return true;
 	}
 	return false;
@@ -616,7 +628,7 @@ bool tuple_eq(SlashValue self, SlashValue other)
 	for (size_t i = 0; i < a->len; i++) {
 		if (!TYPE_EQ(a->items[i], b->items[i]))
 			return false;
-		if (!(a->items[i].T->eq(a->items[i], b->items[i])))
+		if (!(TYPE_OF(a->items[i])->eq(a->items[i], b->items[i])))
 			return false;
 	}
 
@@ -630,8 +642,8 @@ int tuple_hash(SlashValue self)
 	int hash = 5381;
 	for (size_t i = 0; i < tuple->len; i++) {
 		SlashValue this = tuple->items[i];
-		VERIFY_TRAIT_IMPL(hash, this, "Unhashable type '%s'", this.T->name);
-		hash += ((hash << 5) + hash) + this.T->hash(this);
+		VERIFY_TRAIT_IMPL(hash, this, "Unhashable type '%s'", TYPE_OF(this)->name);
+		hash += ((hash << 5) + hash) + TYPE_OF(this)->hash(this);
 	}
 
 	return hash;
@@ -644,24 +656,21 @@ int tuple_hash(SlashValue self)
 SlashValue str_plus(Interpreter *interpreter, SlashValue self, SlashValue other)
 {
 	assert(IS_STR(self) && IS_STR(other));
-	SlashStr *new = (SlashStr *)gc_new_T(interpreter, &str_type_info);
-	gc_barrier_start(&interpreter->gc);
-	slash_str_init_from_concat(interpreter, new, AS_STR(self), AS_STR(other));
-	gc_barrier_end(&interpreter->gc);
-	return AS_VALUE(new);
+	return AS_VALUE(slash_str_new_from_concat(interpreter, AS_STR(self), AS_STR(other)));
 }
 
 SlashValue str_unary_not(SlashValue self)
 {
 	assert(IS_STR(self));
-	TraitTruthy is_truthy = self.T->truthy;
-	return (SlashValue){ .T = &bool_type_info, .boolean = !is_truthy(self) };
+	TraitTruthy is_truthy = TYPE_OF(self)->truthy;
+	return BOOL_VAL(!is_truthy(self));
 }
 
 void str_print(Interpreter *interpreter, SlashValue self)
 {
 	assert(IS_STR(self));
-	SLASH_PRINT(&interpreter->stream_ctx, "\"%s\"", AS_STR(self)->str);
+	SlashStr *str = AS_STR(self);
+	SLASH_PRINT(&interpreter->stream_ctx, "\"%.*s\"", (int)str->len, str->str);
 }
 
 SlashValue str_to_str(Interpreter *interpreter, SlashValue self)
@@ -680,27 +689,27 @@ SlashValue str_item_get(Interpreter *interpreter, SlashValue self, SlashValue ot
 
 	if (IS_NUM(other)) {
 		if (!NUM_IS_INT(other))
-			REPORT_RUNTIME_ERROR("Index can not be a floating point number: '%f", other.num);
-		start = other.num;
+			REPORT_RUNTIME_ERROR("Index can not be a floating point number: '%f", AS_NUM(other));
+		start = AS_NUM(other);
 		end = start + 1;
 		if (start >= str->len)
 			REPORT_RUNTIME_ERROR(
 				"Index out of range. String has len '%zu', tried to get item at index '%zu'",
 				str->len, start);
 	} else if (IS_RANGE(other)) {
-		start = other.range.start;
-		end = other.range.end;
+		start = AS_RANGE(other)->start;
+		end = AS_RANGE(other)->end;
 		if (start > end)
 			REPORT_RUNTIME_ERROR("Reversed range can not be used to get item from string");
+		if (end > str->len)
+			REPORT_RUNTIME_ERROR(
+				"Index out of range. String has len '%zu', tried to get items up to index '%zu'",
+				str->len, end);
 	} else {
-		REPORT_RUNTIME_ERROR("Can not use '%s' as an index", other.T->name);
+		REPORT_RUNTIME_ERROR("Can not use '%s' as an index", TYPE_OF(other)->name);
 	}
 
-	SlashStr *new = (SlashStr *)gc_new_T(interpreter, &str_type_info);
-	gc_barrier_start(&interpreter->gc);
-	slash_str_init_from_slice(interpreter, new, str->str + start, end - start);
-	gc_barrier_end(&interpreter->gc);
-	return AS_VALUE(new);
+	return AS_VALUE(slash_str_new_substr(interpreter, str, start, end - start));
 }
 
 void str_item_assign(Interpreter *interpreter, SlashValue self, SlashValue index, SlashValue other)
@@ -709,11 +718,11 @@ void str_item_assign(Interpreter *interpreter, SlashValue self, SlashValue index
 	assert(IS_STR(other));
 	assert(IS_NUM(index)); // TODO: implement for range
 	if (!NUM_IS_INT(index))
-		REPORT_RUNTIME_ERROR("Str index can not be a floating point number: '%f'", index.num);
+		REPORT_RUNTIME_ERROR("Str index can not be a floating point number: '%f'", AS_NUM(index));
 
 	SlashStr *str = AS_STR(self);
 	/* Ensure the index is valid */
-	int idx = (int)index.num;
+	int idx = (int)AS_NUM(index);
 	if (idx < 0 || (size_t)idx >= str->len)
 		REPORT_RUNTIME_ERROR("Str index '%d' out of range for str with len '%zu'", idx, str->len);
 
@@ -721,16 +730,20 @@ void str_item_assign(Interpreter *interpreter, SlashValue self, SlashValue index
 	if (str_other->len != 1)
 		REPORT_RUNTIME_ERROR("Can only assign a string of length one, not length.");
 
+	/* a shared literal is copied by the caller before it is modified */
+	assert(!str->literal);
+	/* other strs may share the characters */
+	slash_str_make_private(interpreter, str);
 	str->str[idx] = str_other->str[0];
+	str->hash = 0;
 }
 
 bool str_item_in(SlashValue self, SlashValue other)
 {
 	assert(IS_STR(self) && IS_STR(other));
-	char *haystack = AS_STR(self)->str;
-	char *needle = AS_STR(other)->str;
-	char *end_ptr = strstr(haystack, needle);
-	return end_ptr != NULL;
+	SlashStr *haystack = AS_STR(self);
+	SlashStr *needle = AS_STR(other);
+	return memmem(haystack->str, haystack->len, needle->str, needle->len) != NULL;
 }
 
 bool str_truthy(SlashValue self)
@@ -742,28 +755,46 @@ bool str_truthy(SlashValue self)
 int str_cmp(SlashValue self, SlashValue other)
 {
 	assert(IS_STR(self) && IS_STR(other));
-	return strcmp(AS_STR(self)->str, AS_STR(other)->str);
+	/* strs are not necessarily null terminated */
+	SlashStr *a = AS_STR(self);
+	SlashStr *b = AS_STR(other);
+	int rc = memcmp(a->str, b->str, a->len < b->len ? a->len : b->len);
+	if (rc != 0)
+		return rc;
+	return (a->len > b->len) - (a->len < b->len);
 }
 
 bool str_eq(SlashValue self, SlashValue other)
 {
 	assert(IS_STR(self) && IS_STR(other));
-	// NOTE(Nicolai): Easy potential optimisation would be a comparison that returns early
-	//                on the first character that is now the same.
-	return str_cmp(self, other) == 0;
+	SlashStr *a = AS_STR(self);
+	SlashStr *b = AS_STR(other);
+	if (a == b)
+		return true;
+	if (a->len != b->len)
+		return false;
+	/* strs that have been hashed, like map keys, are told apart by their hashes */
+	if (a->hash != 0 && b->hash != 0 && a->hash != b->hash)
+		return false;
+	return memcmp(a->str, b->str, a->len) == 0;
 }
 
 int str_hash(SlashValue self)
 {
 	assert(IS_STR(self));
 	SlashStr *str = AS_STR(self);
+	if (str->hash != 0)
+		return (int)str->hash;
 
 	size_t A = 1327217885;
 	size_t k = 5381;
 	for (size_t i = 0; i < str->len; i++)
 		k += ((k << 5) + k) + (str->str)[i];
 
-	return (int)(k * A);
+	/* 0 means the hash is not computed yet */
+	uint32_t hash = (uint32_t)(k * A);
+	str->hash = hash == 0 ? 1 : hash;
+	return (int)str->hash;
 }
 
 
@@ -783,9 +814,7 @@ SlashValue none_to_str(Interpreter *interpreter, SlashValue self)
 	(void)self;
 	assert(IS_NONE(self));
 
-	SlashObj *str = gc_new_T(interpreter, &str_type_info);
-	slash_str_init_from_slice(interpreter, (SlashStr *)str, "none", 4);
-	return AS_VALUE(str);
+	return AS_VALUE(slash_str_new_from_slice(interpreter, "none", 4));
 }
 
 bool none_truthy(SlashValue self)
@@ -867,7 +896,7 @@ SlashTypeInfo range_type_info = { .name = "range",
 								  .eq = range_eq,
 								  .cmp = NULL,
 								  .hash = NULL,
-								  .obj_size = 0 };
+								  .obj_size = sizeof(SlashRange) };
 
 SlashTypeInfo text_lit_type_info = { .name = "text",
 									 .plus = NULL,
@@ -1017,4 +1046,4 @@ SlashTypeInfo none_type_info = { .name = "none",
 								 .obj_size = 0 };
 
 
-SlashValue NoneSingleton = { .T = &none_type_info };
+SlashValue NoneSingleton = { .bits = NONE_BITS };
@@ -0,0 +1,627 @@
+/*
+ *  Copyright (C) 2024 Nicolai Brand (https://lytix.dev)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "interpreter/compiler.h"
+#include "interpreter/error.h"
+#include "interpreter/gc.h"
+#include "interpreter/interpreter.h"
+#include "interpreter/lexer.h"
+#include "interpreter/line_stream.h"
+#include "interpreter/scope.h"
+#include "interpreter/value/cast.h"
+#include "interpreter/value/slash_list.h"
+#include "interpreter/value/slash_map.h"
+#include "interpreter/value/slash_str.h"
+#include "interpreter/value/slash_value.h"
+#include "interpreter/vm.h"
+#include "lib/arena_ll.h"
+#include "lib/str_view.h"
+#include "nicc/nicc.h"
+#include "options.h"
+#include "sac/sac.h"
+
+
+#define READ_WORD() (*ip++)
+#define READ_NAME() (AS_TEXT_LIT(chunk->constants[READ_WORD()]))
+#define PUSH(__value) (*vm->sp++ = (__value))
+#define POP() (*--vm->sp)
+#define PEEK(__distance) (vm->sp[-1 - (__distance)])
+
+/* Numeric fast path. Any other type goes through the generic binary operator implementation */
+#define NUM_BINARY_OP(__token, __result)                                                       \
+	do {                                                                                       \
+		SlashValue *a = vm->sp - 2;                                                            \
+		SlashValue b = vm->sp[-1];                                                             \
+		if (IS_NUM(*a) && IS_NUM(b))                                                           \
+			*a = (__result);                                                                   \
+		else                                                                                   \
+			*a = eval_binary_operators(interpreter, *a, b, (__token));                         \
+		vm->sp--;                                                                              \
+	} while (0)
+#define NUM_ARITH_OP(__token, __op) NUM_BINARY_OP((__token), NUM_VAL(AS_NUM(*a) __op AS_NUM(b)))
+#define NUM_CMP_OP(__token, __expr) NUM_BINARY_OP((__token), BOOL_VAL(__expr))
+
+
+static inline bool vm_truthy(Interpreter *interpreter, SlashValue value)
+{
+	if (TYPE_OF(value)->truthy == NULL)
+		REPORT_RUNTIME_ERROR("Truthy not defined for type '%s'", TYPE_OF(value)->name);
+	return TYPE_OF(value)->truthy(value);
+}
+
+static void vm_scope_push(Interpreter *interpreter, StrView *slot_names, size_t n_slots)
+{
+	Scope *scope = scope_alloc(interpreter->scope, sizeof(Scope));
+	scope_init_slots(scope, interpreter->scope, slot_names, n_slots);
+	interpreter->scope = scope;
+}
+
+static void vm_scope_pop(Interpreter *interpreter)
+{
+	Scope *scope = interpreter->scope;
+	interpreter->scope = scope->enclosing;
+	scope_destroy(scope);
+	/* give back the memory of the Scope itself */
+	interpreter->scope->arena_tmp.arena->offset -= sizeof(Scope);
+}
+
+/*
+ * Returns the variable referenced by the [depth, slot, name] operands at ip.
+ * The slot is not defined if its definition failed, e.g. a global defined by an earlier line in
+ * the REPL, in which case the variable is looked up by name like the tree-walker would.
+ */
+static inline SlashValue *vm_local(Interpreter *interpreter, Chunk *chunk, uint32_t *ip)
+{
+	Scope *scope = interpreter->scope;
+	for (uint32_t depth = ip[0]; depth > 0; depth--)
+		scope = scope->enclosing;
+	SlashValue *value = &scope->values[ip[1]];
+	if (IS_UNDEFINED(*value)) {
+		StrView *name = AS_TEXT_LIT(chunk->constants[ip[2]]);
+		value = var_get_or_runtime_error(interpreter->scope, name).value;
+	}
+	return value;
+}
+
+static void vm_iter_init(Interpreter *interpreter, VM *vm)
+{
+	SlashValue iterable = PEEK(0);
+	SlashValue items = NoneSingleton;
+
+	if (IS_MAP(iterable)) {
+		SlashMap *map = AS_MAP(iterable);
+		SlashTuple *keys = (SlashTuple *)gc_new_T(interpreter, &tuple_type_info);
+		slash_tuple_init(interpreter, keys, map->len);
+		if (map->len != 0)
+			slash_map_impl_get_keys(map, keys->items);
+		items = AS_VALUE(keys);
+	} else if (IS_STR(iterable)) {
+		ScopeAndValue ifs_res =
+			var_get_or_runtime_error(interpreter->scope, &(StrView){ .view = "IFS", .size = 3 });
+		if (!IS_STR(*ifs_res.value))
+			REPORT_RUNTIME_ERROR("$IFS has to be of type 'str', but got '%s'",
+								 TYPE_OF(*ifs_res.value)->name);
+		char *ifs = slash_str_cstr(interpreter, AS_STR(*ifs_res.value));
+		SlashList *substrings = slash_str_split(interpreter, AS_STR(iterable), ifs, true);
+		items = AS_VALUE(substrings);
+	} else if (!(IS_RANGE(iterable) || IS_LIST(iterable) || IS_TUPLE(iterable) ||
+				 IS_LINE_STREAM(iterable))) {
+		REPORT_RUNTIME_ERROR("Type '%s' can not be iterated over", TYPE_OF(iterable)->name);
+	}
+
+	PUSH(items);
+	PUSH(NUM_VAL(0));
+}
+
+/* Returns false if the iterator on top of the stack is exhausted */
+static bool vm_iter_next(Interpreter *interpreter, VM *vm, SlashValue *next)
+{
+	SlashValue *iter = vm->sp - 3;
+	SlashValue seq = IS_NONE(iter[1]) ? iter[0] : iter[1];
+	size_t i = (size_t)AS_NUM(iter[2]);
+
+	if (IS_LINE_STREAM(seq)) {
+		return line_stream_next(interpreter, AS_LINE_STREAM(seq), next);
+	} else if (IS_RANGE(seq)) {
+		if ((int64_t)AS_RANGE(seq)->start + (int64_t)i >= AS_RANGE(seq)->end)
+			return false;
+		*next = NUM_VAL(AS_RANGE(seq)->start + (int64_t)i);
+	} else if (IS_LIST(seq)) {
+		SlashList *list = AS_LIST(seq);
+		if (i >= list->len)
+			return false;
+		*next = slash_list_impl_get(list, i);
+	} else {
+		SlashTuple *tuple = AS_TUPLE(seq);
+		if (i >= tuple->len)
+			return false;
+		*next = tuple->items[i];
+	}
+
+	iter[2] = NUM_VAL(i + 1);
+	return true;
+}
+
+/* The n values on top of the stack are about to become arguments or items of a container */
+static void vm_unshare_items(Interpreter *interpreter, VM *vm, uint32_t n)
+{
+	for (SlashValue *item = vm->sp - n; item < vm->sp; item++)
+		*item = str_pool_unshare(interpreter, *item);
+}
+
+static void vm_call(Interpreter *interpreter, VM *vm, uint32_t argc)
+{
+	SlashValue *args = vm->sp - argc;
+	SlashValue callee = args[-1];
+	if (!IS_FUNCTION(callee))
+		REPORT_RUNTIME_ERROR("Can not call value of type '%s'", TYPE_OF(callee)->name);
+
+	SlashFunction *function = AS_FUNCTION(callee);
+	/* Arity check */
+	if (function->params.size != argc)
+		REPORT_RUNTIME_ERROR("Function 'FOO' takes '%zu' arguments, but '%u' where given",
+							 function->params.size, argc);
+
+	/* Function values created by the tree-walker are compiled for every call */
+	Chunk uncached_chunk;
+	Chunk *chunk = function->chunk;
+	if (chunk == NULL) {
+		compile_function(&uncached_chunk, &interpreter->str_pool, &function->params,
+						 function->body);
+		chunk = &uncached_chunk;
+	}
+
+	/* Arguments go into the first slots of the frame */
+	vm_unshare_items(interpreter, vm, argc);
+	vm_scope_push(interpreter, chunk->slot_names + chunk->frame_names, chunk->frame_slots);
+	if (argc != 0)
+		memcpy(interpreter->scope->values, args, sizeof(SlashValue) * argc);
+	vm->sp = args - 1;
+
+	SlashValue return_value = vm_run(interpreter, chunk);
+	vm_scope_pop(interpreter);
+	if (chunk == &uncached_chunk)
+		chunk_free(&uncached_chunk);
+	PUSH(return_value);
+}
+
+static void vm_subscript_assign(Interpreter *interpreter, VM *vm, StrView *var_name,
+								TokenType op)
+{
+	SlashValue access_index = PEEK(1);
+	SlashValue new_value = PEEK(0);
+
+	ScopeAndValue current = var_get_or_runtime_error(interpreter->scope, var_name);
+	/* the underlying self who's index (access_index) we're trying to modify */
+	SlashValue self = *current.value;
+	VERIFY_TRAIT_IMPL(item_assign, self, "Item assignment not defined for type '%s'",
+					  TYPE_OF(self)->name);
+	/* a str copies the new value into itself, anything else holds on to the key and the value */
+	if (!IS_STR(self)) {
+		PEEK(1) = access_index = str_pool_unshare(interpreter, access_index);
+		PEEK(0) = new_value = str_pool_unshare(interpreter, new_value);
+	}
+
+	if (op != t_equal) {
+		VERIFY_TRAIT_IMPL(item_get, self, "'[]' operator not defined for type '%s'",
+						  TYPE_OF(self)->name);
+		SlashValue current_item_value = TYPE_OF(self)->item_get(interpreter, self, access_index);
+		new_value = eval_binary_operators(interpreter, current_item_value, new_value, op);
+		/* keep the new value reachable */
+		PEEK(0) = new_value;
+	}
+
+	TYPE_OF(self)->item_assign(interpreter, self, access_index, new_value);
+	vm->sp -= 2;
+}
+
+void vm_unwind(Interpreter *interpreter, SlashValue *sp)
+{
+	VM *vm = &interpreter->vm;
+	/* a loop over a line stream that is left early stops its subshell, see OP_ITER_END */
+	for (SlashValue *value = sp; value < vm->sp; value++) {
+		if (IS_LINE_STREAM(*value))
+			line_stream_close(interpreter, AS_LINE_STREAM(*value));
+	}
+	vm->sp = sp;
+}
+
+SlashValue vm_run(Interpreter *interpreter, Chunk *chunk)
+{
+	VM *vm = &interpreter->vm;
+	if (vm->sp + chunk->max_stack > vm->stack_end)
+		REPORT_RUNTIME_ERROR("Stack overflow");
+
+	Scope *frame_scope = interpreter->scope;
+	SlashValue *frame_sp = vm->sp;
+	uint32_t *ip = chunk->code;
+
+	while (true) {
+		switch ((OpCode)READ_WORD()) {
+		case OP_CONSTANT:
+			PUSH(chunk->constants[READ_WORD()]);
+			break;
+		case OP_NONE:
+			PUSH(NoneSingleton);
+			break;
+		case OP_TRUE:
+			PUSH((BOOL_VAL(true)));
+			break;
+		case OP_FALSE:
+			PUSH((BOOL_VAL(false)));
+			break;
+		case OP_STR: {
+			/* the view is the first member of the pool entry of the literal */
+			StrPoolEntry *entry = (StrPoolEntry *)READ_NAME();
+			SlashStr *str = str_pool_get(interpreter, entry);
+			PUSH(AS_VALUE(str));
+			break;
+		}
+		case OP_POP:
+			vm->sp--;
+			break;
+		case OP_POPN:
+			vm->sp -= READ_WORD();
+			break;
+		case OP_PRINT: {
+			SlashValue value = PEEK(0);
+			VERIFY_TRAIT_IMPL(print, value, "TODO");
+			TYPE_OF(value)->print(interpreter, value);
+			SLASH_PRINT(&interpreter->stream_ctx, "\n");
+			vm->sp--;
+			break;
+		}
+		case OP_LINE:
+			interpreter->source_line = READ_WORD();
+			break;
+
+		case OP_GET_VAR: {
+			ScopeAndValue sv = var_get_or_runtime_error(interpreter->scope, READ_NAME());
+			PUSH(*sv.value);
+			break;
+		}
+		case OP_SET_VAR: {
+			ScopeAndValue variable = var_get_or_runtime_error(interpreter->scope, READ_NAME());
+			*variable.value = str_pool_unshare(interpreter, PEEK(0));
+			vm->sp--;
+			break;
+		}
+		case OP_GET_LOCAL: {
+			SlashValue *value = vm_local(interpreter, chunk, ip);
+			ip += 3;
+			PUSH(*value);
+			break;
+		}
+		case OP_DEFINE_LOCAL: {
+			SlashValue *value = &interpreter->scope->values[READ_WORD()];
+			/* Make sure variable is not defined already */
+			if (!IS_UNDEFINED(*value)) {
+				str_view_to_buf_cstr(interpreter->scope->names[ip[-1]]); // creates buf variable
+				REPORT_RUNTIME_ERROR("Redefinition of '%s'", buf);
+			}
+			*value = str_pool_unshare(interpreter, PEEK(0));
+			vm->sp--;
+			break;
+		}
+		case OP_SET_LOCAL: {
+			SlashValue *value = vm_local(interpreter, chunk, ip);
+			ip += 3;
+			*value = str_pool_unshare(interpreter, PEEK(0));
+			vm->sp--;
+			break;
+		}
+
+		case OP_ADD:
+			NUM_ARITH_OP(t_plus, +);
+			break;
+		case OP_ADD_TMP:
+			if (IS_STR(PEEK(1)) && IS_STR(PEEK(0))) {
+				gc_tmp_begin(&interpreter->gc, &interpreter->tmp_arena);
+				PEEK(1) = eval_binary_operators(interpreter, PEEK(1), PEEK(0), t_plus);
+				gc_tmp_end(&interpreter->gc);
+				vm->sp--;
+			} else {
+				NUM_ARITH_OP(t_plus, +);
+			}
+			break;
+		case OP_SUB:
+			NUM_ARITH_OP(t_minus, -);
+			break;
+		case OP_MUL:
+			NUM_ARITH_OP(t_star, *);
+			break;
+		case OP_EQ:
+			NUM_CMP_OP(t_equal_equal, AS_NUM(*a) == AS_NUM(b));
+			break;
+		case OP_NE:
+			NUM_CMP_OP(t_bang_equal, AS_NUM(*a) != AS_NUM(b));
+			break;
+		case OP_GT:
+			NUM_CMP_OP(t_greater, AS_NUM(*a) > AS_NUM(b));
+			break;
+		case OP_GE:
+			NUM_CMP_OP(t_greater_equal, !(AS_NUM(*a) < AS_NUM(b)));
+			break;
+		case OP_LT:
+			NUM_CMP_OP(t_less, AS_NUM(*a) < AS_NUM(b));
+			break;
+		case OP_LE:
+			NUM_CMP_OP(t_less_equal, !(AS_NUM(*a) > AS_NUM(b)));
+			break;
+		case OP_BINARY: {
+			TokenType op = READ_WORD();
+			PEEK(1) = eval_binary_operators(interpreter, PEEK(1), PEEK(0), op);
+			vm->sp--;
+			break;
+		}
+		case OP_OR: {
+			bool truthy = vm_truthy(interpreter, PEEK(1)) || vm_truthy(interpreter, PEEK(0));
+			vm->sp -= 2;
+			PUSH((BOOL_VAL(truthy)));
+			break;
+		}
+		case OP_IN: {
+			SlashValue left = PEEK(1);
+			SlashValue right = PEEK(0);
+			VERIFY_TRAIT_IMPL(item_in, right, "'in' operator not defined for type '%s'",
+							  TYPE_OF(right)->name);
+			bool rc = TYPE_OF(right)->item_in(right, left);
+			vm->sp -= 2;
+			PUSH((BOOL_VAL(rc)));
+			break;
+		}
+		case OP_RANGE: {
+			SlashValue left = PEEK(1);
+			SlashValue right = PEEK(0);
+			if (!(IS_NUM(left) && NUM_IS_INT(left) && IS_NUM(right) && NUM_IS_INT(right)))
+				REPORT_RUNTIME_ERROR("Bad range initializer");
+			vm->sp -= 2;
+			PUSH(slash_range_new(interpreter, AS_NUM(left), AS_NUM(right)));
+			break;
+		}
+		case OP_NOT: {
+			SlashValue right = PEEK(0);
+			VERIFY_TRAIT_IMPL(unary_not, right, "'not' operator not defined for type '%s'",
+							  TYPE_OF(right)->name);
+			PEEK(0) = TYPE_OF(right)->unary_not(right);
+			break;
+		}
+		case OP_NEGATE: {
+			SlashValue right = PEEK(0);
+			if (IS_NUM(right)) {
+				PEEK(0) = NUM_VAL(-AS_NUM(right));
+				break;
+			}
+			VERIFY_TRAIT_IMPL(unary_minus, right, "Unary '-' not defined for type '%s'",
+							  TYPE_OF(right)->name);
+			PEEK(0) = TYPE_OF(right)->unary_minus(right);
+			break;
+		}
+		case OP_TRUTHY:
+			PEEK(0) = BOOL_VAL(vm_truthy(interpreter, PEEK(0)));
+			break;
+
+		case OP_SUBSCRIPT: {
+			SlashValue value = PEEK(1);
+			SlashValue access_index = PEEK(0);
+			VERIFY_TRAIT_IMPL(item_get, value, "'[]' operator not defined for type '%s'",
+							  TYPE_OF(value)->name);
+			PEEK(1) = TYPE_OF(value)->item_get(interpreter, value, access_index);
+			vm->sp--;
+			break;
+		}
+		case OP_SUBSCRIPT_ASSIGN: {
+			StrView *name = READ_NAME();
+			TokenType op = READ_WORD();
+			vm_subscript_assign(interpreter, vm, name, op);
+			break;
+		}
+		case OP_LIST: {
+			uint32_t n = READ_WORD();
+			vm_unshare_items(interpreter, vm, n);
+			SlashList *list = (SlashList *)gc_new_T(interpreter, &list_type_info);
+			slash_list_impl_init(interpreter, list);
+			/* keep the list reachable as appending may trigger the GC */
+			PUSH(AS_VALUE(list));
+			SlashValue *items = vm->sp - 1 - n;
+			for (uint32_t i = 0; i < n; i++)
+				slash_list_impl_append(interpreter, list, items[i]);
+			vm->sp = items;
+			PUSH(AS_VALUE(list));
+			break;
+		}
+		case OP_TUPLE: {
+			uint32_t n = READ_WORD();
+			vm_unshare_items(interpreter, vm, n);
+			SlashTuple *tuple = (SlashTuple *)gc_new_T(interpreter, &tuple_type_info);
+			slash_tuple_init(interpreter, tuple, n);
+			vm->sp -= n;
+			if (n != 0)
+				memcpy(tuple->items, vm->sp, sizeof(SlashValue) * n);
+			PUSH(AS_VALUE(tuple));
+			break;
+		}
+		case OP_MAP: {
+			uint32_t n = READ_WORD();
+			vm_unshare_items(interpreter, vm, 2 * n);
+			SlashMap *map = (SlashMap *)gc_new_T(interpreter, &map_type_info);
+			slash_map_impl_init(interpreter, map);
+			/* keep the map reachable as putting may trigger the GC */
+			PUSH(AS_VALUE(map));
+			SlashValue *pairs = vm->sp - 1 - 2 * n;
+			for (uint32_t i = 0; i < n; i++)
+				slash_map_impl_put(interpreter, map, pairs[2 * i], pairs[2 * i + 1]);
+			vm->sp = pairs;
+			PUSH(AS_VALUE(map));
+			break;
+		}
+		case OP_CAST: {
+			StrView *type_name = READ_NAME();
+			PEEK(0) = dynamic_cast(interpreter, PEEK(0), *type_name);
+			break;
+		}
+		case OP_CAST_TMP: {
+			StrView *type_name = READ_NAME();
+			/* to_str only allocates the str it returns */
+			gc_tmp_begin(&interpreter->gc, &interpreter->tmp_arena);
+			PEEK(0) = dynamic_cast(interpreter, PEEK(0), *type_name);
+			gc_tmp_end(&interpreter->gc);
+			break;
+		}
+		case OP_TMP_BEGIN:
+			PUSH(NUM_VAL(interpreter->tmp_arena.offset));
+			break;
+		case OP_TMP_END: {
+			SlashValue value = POP();
+			interpreter->tmp_arena.offset = AS_NUM(PEEK(0));
+			PEEK(0) = value;
+			break;
+		}
+		case OP_EXIT_CODE:
+			PUSH((BOOL_VAL(interpreter->prev_exit_code == 0)));
+			break;
+		case OP_UNPACK: {
+			uint32_t n = READ_WORD();
+			SlashValue value = PEEK(0);
+			if (!IS_TUPLE(value))
+				REPORT_RUNTIME_ERROR("Multiple variable declaration only supported for tuples");
+			SlashTuple *tuple = AS_TUPLE(value);
+			if (tuple->len != n)
+				REPORT_RUNTIME_ERROR("Unpacking only supported for collections of the same size");
+			vm->sp--;
+			memcpy(vm->sp, tuple->items, sizeof(SlashValue) * n);
+			vm->sp += n;
+			break;
+		}
+		case OP_ASSERT:
+			if (!vm_truthy(interpreter, POP()))
+				REPORT_RUNTIME_ERROR("Assertion failed");
+			break;
+
+		case OP_JUMP: {
+			uint32_t offset = READ_WORD();
+			ip += offset;
+			break;
+		}
+		case OP_JUMP_IF_FALSE: {
+			uint32_t offset = READ_WORD();
+			if (!vm_truthy(interpreter, POP()))
+				ip += offset;
+			break;
+		}
+		case OP_JUMP_IF_TRUE: {
+			uint32_t offset = READ_WORD();
+			if (vm_truthy(interpreter, POP()))
+				ip += offset;
+			break;
+		}
+		case OP_LOOP: {
+			uint32_t offset = READ_WORD();
+			ip -= offset;
+			break;
+		}
+
+		case OP_PUSH_SCOPE: {
+			uint32_t n_slots = READ_WORD();
+			vm_scope_push(interpreter, chunk->slot_names + READ_WORD(), n_slots);
+			break;
+		}
+		case OP_POP_SCOPE:
+			vm_scope_pop(interpreter);
+			break;
+		case OP_RESET_SCOPE:
+			scope_reset(interpreter->scope);
+			break;
+		case OP_ITER_INIT:
+			vm_iter_init(interpreter, vm);
+			break;
+		case OP_ITER_NEXT: {
+			uint32_t slot = READ_WORD();
+			uint32_t offset = READ_WORD();
+			if (!vm_iter_next(interpreter, vm, &interpreter->scope->values[slot]))
+				ip += offset;
+			break;
+		}
+		case OP_ITER_END: {
+			SlashValue iterable = PEEK(2);
+			/* a break leaves the subshell running, so stop it and get its exit code */
+			if (IS_LINE_STREAM(iterable))
+				line_stream_close(interpreter, AS_LINE_STREAM(iterable));
+			vm->sp -= 3;
+			break;
+		}
+		case OP_LINE_STREAM: {
+			SubshellExpr *expr = chunk->nodes[READ_WORD()];
+			PUSH(line_stream_or_capture(interpreter, expr));
+			break;
+		}
+
+		case OP_FUNCTION: {
+			Expr *expr = chunk->nodes[READ_WORD()];
+			SlashValue function = tree_walk_eval(interpreter, expr);
+			Chunk function_chunk;
+			SlashFunction *f = AS_FUNCTION(function);
+			compile_function(&function_chunk, &interpreter->str_pool, &f->params, f->body);
+			f->chunk =
+				chunk_move_to_arena(interpreter->scope->arena_tmp.arena, &function_chunk);
+			PUSH(function);
+			break;
+		}
+		case OP_CALL:
+			vm_call(interpreter, vm, READ_WORD());
+			break;
+		case OP_RETURN: {
+			SlashValue return_value = POP();
+			/* unwind any scopes left open by abrupt control flow */
+			while (interpreter->scope != frame_scope)
+				vm_scope_pop(interpreter);
+			vm_unwind(interpreter, frame_sp);
+			return return_value;
+		}
+
+		case OP_EVAL_EXPR: {
+			SlashValue value = tree_walk_eval(interpreter, chunk->nodes[READ_WORD()]);
+			PUSH(value);
+			break;
+		}
+		case OP_EXEC_STMT:
+			tree_walk_exec(interpreter, chunk->nodes[READ_WORD()]);
+			break;
+
+		default:
+			REPORT_RUNTIME_ERROR("Internal error: opcode not recognized");
+		}
+	}
+}
+
+void vm_init(VM *vm)
+{
+	vm->stack = malloc(sizeof(SlashValue) * VM_STACK_MAX);
+	vm->sp = vm->stack;
+	vm->stack_end = vm->stack + VM_STACK_MAX;
+}
+
+void vm_free(VM *vm)
+{
+	free(vm->stack);
+	vm->stack = NULL;
+	vm->sp = NULL;
+	vm->stack_end = NULL;
+}
@@ -25,6 +25,7 @@
 #include "interactive/prompt.h"
 #include "interpreter/ast.h"
 #include "interpreter/error.h"
+#include "interpreter/gc.h"
 #include "interpreter/interpreter.h"
 #include "interpreter/lexer.h"
 #include "interpreter/parser.h"
@@ -34,10 +35,13 @@
 #include "nicc/nicc.h"
 
 
-void interactive(int argc, char **argv)
+void interactive(int argc, char **argv, bool tree_walk, size_t max_heap)
 {
 	Interpreter interpreter = { 0 };
 	interpreter_init(&interpreter, argc, argv);
+	interpreter.tree_walk = tree_walk;
+	interpreter.gc.max_heap = max_heap;
+	gc_set_next_run(&interpreter.gc);
 	Arena ast_arena;
 	ast_arena_init(&ast_arena);
 	Prompt prompt;
@@ -85,10 +89,60 @@ continue_repl:
 	prompt_free(&prompt);
 }
 
+/* Parses a size in bytes with an optional K, M or G suffix. Returns 0 on failure */
+static size_t parse_size(char *str)
+{
+	char *end;
+	unsigned long long size = strtoull(str, &end, 10);
+	if (end == str)
+		return 0;
+	switch (*end) {
+	case 'K':
+	case 'k':
+		size <<= 10;
+		end++;
+		break;
+	case 'M':
+	case 'm':
+		size <<= 20;
+		end++;
+		break;
+	case 'G':
+	case 'g':
+		size <<= 30;
+		end++;
+		break;
+	}
+	return *end == 0 ? size : 0;
+}
+
 int main(int argc, char **argv)
 {
+	bool tree_walk = false;
+	size_t max_heap = 0;
+	while (argc > 1) {
+		int consumed;
+		if (strcmp(argv[1], "--tree-walk") == 0) {
+			/* interpret by walking the AST instead of compiling to bytecode */
+			tree_walk = true;
+			consumed = 1;
+		} else if (strcmp(argv[1], "--max-heap") == 0) {
+			/* bytes the GC may manage before a collection is forced and allocations fail */
+			if (argc == 2 || (max_heap = parse_size(argv[2])) == 0) {
+				REPORT_IMPL("Size expected for the --max-heap flag\n");
+				return 2;
+			}
+			consumed = 2;
+		} else {
+			break;
+		}
+		argv[consumed] = argv[0];
+		argv += consumed;
+		argc -= consumed;
+	}
+
 	if (argc == 1) {
-		interactive(argc, argv);
+		interactive(argc, argv, tree_walk, max_heap);
 		return 0;
 	}
 
@@ -186,7 +240,7 @@ int main(int argc, char **argv)
 #endif /* DEBUG_PERF */
 
 	/* interpret */
-	exit_code = interpret(&parse_result.stmts, argc - 1, argv + 1);
+	exit_code = interpret(&parse_result.stmts, argc - 1, argv + 1, tree_walk, max_heap);
 
 #ifdef DEBUG_PERF
 	end_time = clock();